@@ -7,11 +7,12 @@
 
 #include <stdlib.h>
 
+#include "config.h"
 #include "ring.h"
 #include "hash.h"
 #include "cache.h"
 
-#define CACHE_ADDR_SIZE 20
+#define CACHE_ADDR_SIZE CONFIG_CACHE_SIZE
 
 /**
  * Ring containing the active loco addresses.
@@ -141,3 +142,11 @@ Cache_report_total_size(void)
 {
     return CACHE_ADDR_SIZE;
 }
+
+extern int
+Cache_report_address(int i)
+{
+    /* The i'th active loco, in refresh order. */
+    return Cache_addresses->buf[(Cache_addresses->start + i)
+        % Cache_addresses->size].i;
+}
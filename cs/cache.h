@@ -23,5 +23,6 @@ extern DCC_packet_T Cache_get_next_packet(void);
 extern DCC_packet_T Cache_get(int address);
 extern int          Cache_report_current_size(void);
 extern int          Cache_report_total_size(void);
+extern int          Cache_report_address(int i);
 
 #endif
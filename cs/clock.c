@@ -0,0 +1,71 @@
+/**
+ * @file clock.c
+ * @brief Implements the system millisecond clock.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include "hal.h"
+#include "clock.h"
+
+#define CLOCK_TICK_MS       8   /**< Whole milliseconds per flush period. */
+#define CLOCK_TICK_FRAC     49  /**< Remaining 72nds of a millisecond per flush period. */
+#define CLOCK_COUNT_FRAC    5   /**< 72nds of a millisecond per TIMER0 count. */
+#define CLOCK_FRAC_ONE      72
+
+static volatile uint32_t Clock_ms;
+static volatile uint8_t Clock_frac;
+
+extern void
+Clock_module_init(void)
+{
+    HAL_ATOMIC_BLOCK
+    {
+        Clock_ms = 0;
+        Clock_frac = 0;
+    }
+}
+
+extern void
+Clock_tick(void)
+{
+    Clock_ms += CLOCK_TICK_MS;
+    Clock_frac += CLOCK_TICK_FRAC;
+
+    if(Clock_frac >= CLOCK_FRAC_ONE)
+    {
+        Clock_ms++;
+        Clock_frac -= CLOCK_FRAC_ONE;
+    }
+}
+
+extern uint32_t
+Clock_tick_millis(void)
+{
+    return Clock_ms;
+}
+
+extern uint32_t
+Clock_millis(void)
+{
+    uint32_t ms;
+    uint16_t frac;
+    uint8_t count;
+
+    HAL_ATOMIC_BLOCK
+    {
+        ms = Clock_ms;
+        frac = Clock_frac;
+        count = HAL_SCHEDULER_COUNT();
+
+        /* The counter may have been reset before the handler could run. */
+        if(HAL_SCHEDULER_PENDING())
+        {
+            ms += CLOCK_TICK_MS;
+            frac += CLOCK_TICK_FRAC;
+            count = HAL_SCHEDULER_COUNT();
+        }
+    }
+
+    return ms + ((frac + (count * CLOCK_COUNT_FRAC)) / CLOCK_FRAC_ONE);
+}
@@ -0,0 +1,47 @@
+/**
+ * @file clock.h
+ * @brief Defines the system millisecond clock.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * A monotonic 32 bit millisecond uptime clock, derived from the scheduler
+ * flush timer (TIMER0) so no extra timer or interrupt is needed. It wraps
+ * after about 49 days.
+ *
+ * Each flush period is 128000 cpu cycles, or 8 and 49/72 milliseconds at
+ * 14.7456MHz. The whole milliseconds are accumulated directly and the
+ * 72nds carried, so the clock does not drift. Between flush periods, the
+ * TIMER0 count adds 5/72 of a millisecond per increment.
+ */
+
+#ifndef CLOCK_DEFINED
+#define CLOCK_DEFINED
+
+#include <stdint.h>
+
+/** Reset the clock to zero. */
+extern void Clock_module_init(void);
+
+/**
+ * Advance the clock by one flush period. Called only by the scheduler
+ * interrupt handler.
+ */
+extern void Clock_tick(void);
+
+/**
+ * Read the clock as of the last flush period, without interpolating. This
+ * is cheap enough for the scheduler interrupt handler, which has just
+ * advanced the clock.
+ *
+ * @return Milliseconds since the clock was initialised.
+ */
+extern uint32_t Clock_tick_millis(void);
+
+/**
+ * Read the clock.
+ *
+ * @return Milliseconds since the clock was initialised.
+ */
+extern uint32_t Clock_millis(void);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file config.h
+ * @brief Defines the build time configuration of the command station.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Every buffer, queue and table size lives here, so memory can be traded
+ * against capacity for each deployment in one place. A profile is chosen
+ * at build time (see the Makefile), defining CONFIG_PROFILE_LARGE for the
+ * large profile, eg:
+ *
+ * @code
+ * make small     # ATmega644P, 4KB RAM, a club layout (the default)
+ * make large     # ATmega1284P, 16KB RAM, a large layout
+ * @endcode
+ *
+ * The static assertions at the end check that the chosen sizes are
+ * consistent with each other and fit the RAM of the target.
+ */
+
+#ifndef CONFIG_DEFINED
+#define CONFIG_DEFINED
+
+#define F_CPU 14745600UL
+
+#if defined(CONFIG_PROFILE_LARGE)
+
+#define CONFIG_RAM_SIZE         16384   /**< ATmega1284P. */
+#define CONFIG_STACK_RESERVE    2048    /**< RAM kept free for the stack. */
+#define CONFIG_TX_QUEUE_LEN     32      /**< New packets waiting for the track. */
+#define CONFIG_CACHE_SIZE       64      /**< Locos refreshed. */
+#define CONFIG_RX_BUFFER_LEN    128     /**< Received characters waiting to be parsed. */
+#define CONFIG_TRACE_LEN        64      /**< Packets kept in the trace, a power of two. */
+
+#else   /* The small profile, unless another is chosen. */
+
+#define CONFIG_RAM_SIZE         4096    /**< ATmega644P. */
+#define CONFIG_STACK_RESERVE    1024    /**< RAM kept free for the stack. */
+#define CONFIG_TX_QUEUE_LEN     20      /**< New packets waiting for the track. */
+#define CONFIG_CACHE_SIZE       20      /**< Locos refreshed. */
+#define CONFIG_RX_BUFFER_LEN    50      /**< Received characters waiting to be parsed. */
+#define CONFIG_TRACE_LEN        16      /**< Packets kept in the trace, a power of two. */
+
+#endif
+
+/*
+ * Settings common to every profile.
+ */
+#define CONFIG_BAUD_RATE        9600
+#define CONFIG_MAX_PACKET_SIZE  15      /**< Largest packet in bytes, including the preamble. */
+#define CONFIG_DSL_MAX_TOK_LEN  20      /**< Longest DSL word. */
+#define CONFIG_STATIC_RESERVE   512     /**< Other static data and heap overheads. */
+
+/**
+ * The packet pool holds the transmit queue and cache, plus the idle
+ * packet, the stored broadcast stop packet, a packet being parsed and a
+ * packet on its way from the parser to the queue.
+ */
+#define CONFIG_PACKET_POOL_SIZE (CONFIG_TX_QUEUE_LEN + CONFIG_CACHE_SIZE + 4)
+
+/*
+ * Estimated RAM use of the configured buffers, with two byte ints and
+ * pointers. A packet is its bytes, size, sequence number and stamp.
+ */
+#define CONFIG_PACKET_BYTES     (CONFIG_MAX_PACKET_SIZE + 6)
+#define CONFIG_RAM_ESTIMATE     ((CONFIG_PACKET_POOL_SIZE * (CONFIG_PACKET_BYTES + 2)) \
+                                 + (CONFIG_TRACE_LEN * CONFIG_PACKET_BYTES) \
+                                 + (((CONFIG_TX_QUEUE_LEN * 2) + CONFIG_RX_BUFFER_LEN \
+                                     + CONFIG_CACHE_SIZE) * 2) \
+                                 + (CONFIG_CACHE_SIZE * 8) \
+                                 + CONFIG_STATIC_RESERVE + CONFIG_STACK_RESERVE)
+
+_Static_assert((CONFIG_TRACE_LEN & (CONFIG_TRACE_LEN - 1)) == 0,
+               "CONFIG_TRACE_LEN must be a power of two");
+_Static_assert(CONFIG_CACHE_SIZE <= 128,
+               "CONFIG_CACHE_SIZE exceeds the number of baseline addresses");
+_Static_assert(CONFIG_MAX_PACKET_SIZE >= 5,
+               "CONFIG_MAX_PACKET_SIZE cannot hold a baseline packet");
+_Static_assert(CONFIG_RAM_ESTIMATE <= CONFIG_RAM_SIZE,
+               "configured buffers exceed the RAM budget");
+
+#endif
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "hal.h"
 #include "dcc.h"
 
 #define T DCC_packet_T
@@ -63,14 +64,51 @@ static unsigned char DCC_speed_steps[] = {
     0x1F    /**< Step 28 */
 };
 
+/**
+ * The static packet pool, the stack of free packets within it and which
+ * packets are in use.
+ */
+static struct T DCC_pool[DCC_POOL_SIZE];
+static T DCC_pool_free[DCC_POOL_SIZE];
+static int DCC_pool_free_count = -1;
+static uint8_t DCC_pool_used[DCC_POOL_SIZE];
+
+static void DCC_put_bit(T packet, int bit, int value);
+
 extern T
 DCC_packet_create(int size)
 {
-    T packet;
+    int i;
+    T packet = NULL;
 
-    packet = calloc(1, sizeof(*packet));
-    packet->bytes = calloc(size, sizeof(char));
-    packet->size = size;
+    if(size > DCC_MAX_PACKET_SIZE)
+        return NULL;
+
+    /* Packets are created and destroyed from both interrupt and main context. */
+    HAL_ATOMIC_BLOCK
+    {
+        if(DCC_pool_free_count < 0)
+        {
+            /* First use, every packet is free. */
+            for(i=0; i < DCC_POOL_SIZE; i++)
+                DCC_pool_free[i] = &DCC_pool[i];
+
+            DCC_pool_free_count = DCC_POOL_SIZE;
+        }
+
+        if(DCC_pool_free_count > 0)
+        {
+            packet = DCC_pool_free[--DCC_pool_free_count];
+            DCC_pool_used[packet - DCC_pool] = 1;
+        }
+    }
+
+    if(packet)
+    {
+        memset(packet->bytes, 0, sizeof(packet->bytes));
+        packet->size = size;
+        packet->seq = DCC_SEQ_NONE;
+    }
 
     return packet;
 }
@@ -81,22 +119,81 @@ DCC_baseline_packet_create(void)
     return DCC_packet_create(DCC_BASELINE_LEN);
 }
 
+extern T
+DCC_framed_packet_create(const unsigned char *data, int size)
+{
+    T packet;
+    int i, j, bit;
+    unsigned char byte, checksum = 0;
+
+    if(size < 1 || DCC_FRAMED_SIZE(size) > DCC_MAX_PACKET_SIZE)
+        return NULL;
+
+    if((packet = DCC_packet_create(DCC_FRAMED_SIZE(size))) == NULL)
+        return NULL;
+
+    /* All ones covers the preamble, the end bit and any trailing padding. */
+    memset(packet->bytes, 0xFF, packet->size);
+
+    bit = DCC_PREAMBLE_BITS;
+    for(i=0; i <= size; i++)
+    {
+        /* The error detection byte follows the data. */
+        byte = (i < size ? data[i] : checksum);
+        checksum ^= byte;
+
+        /* Start bit. */
+        DCC_put_bit(packet, bit++, 0);
+
+        for(j=7; j >= 0; j--)
+            DCC_put_bit(packet, bit++, byte & (1 << j));
+    }
+
+    return packet;
+}
+
 extern void
 DCC_packet_destroy(T packet)
 {
-    if(packet && packet->bytes)
-        free(packet->bytes);
+    int i;
 
-    packet->bytes = NULL;
+    if(packet == NULL)
+        return;
 
-    if(packet)
-        free(packet);
+    /* Ignore packets not from the pool, or already returned to it. */
+    if(packet < DCC_pool || packet >= (DCC_pool + DCC_POOL_SIZE))
+        return;
+
+    i = packet - DCC_pool;
+    if(packet != &DCC_pool[i])
+        return;
 
-    packet = NULL;
+    HAL_ATOMIC_BLOCK
+    {
+        if(DCC_pool_used[i] && DCC_pool_free_count < DCC_POOL_SIZE)
+        {
+            DCC_pool_used[i] = 0;
+            DCC_pool_free[DCC_pool_free_count++] = packet;
+        }
+    }
 
     return;
 }
 
+extern int
+DCC_pool_report_free(void)
+{
+    int nfree;
+
+    HAL_ATOMIC_BLOCK
+    {
+        /* The pool is filled on first use. */
+        nfree = (DCC_pool_free_count < 0 ? DCC_POOL_SIZE : DCC_pool_free_count);
+    }
+
+    return nfree;
+}
+
 extern int
 DCC_compare_speed(T p1, T p2)
 {
@@ -419,3 +516,13 @@ DCC_byte_dump_hex(unsigned char byte)
 
     return;
 }
+
+static void
+DCC_put_bit(T packet, int bit, int value)
+{
+    /* Bits are sent from the most significant bit of the first byte. */
+    if(value)
+        packet->bytes[bit / 8] |= (0x80 >> (bit % 8));
+    else
+        packet->bytes[bit / 8] &= ~(0x80 >> (bit % 8));
+}
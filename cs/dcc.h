@@ -8,10 +8,21 @@
 #ifndef DCC_INCLUDED
 #define DCC_INCLUDED
 
+#include <stdint.h>
+
+#include "config.h"
+
 #define DCC_DIRECTION_FORWARD   1
 #define DCC_DIRECTION_REVERSE   0
 #define DCC_ADDRESS_MAX         128
 #define DCC_MAX_SPEED_STEPS     29
+#define DCC_MAX_PACKET_SIZE     CONFIG_MAX_PACKET_SIZE  /**< Largest packet, in bytes, the signal module can send. */
+#define DCC_POOL_SIZE           CONFIG_PACKET_POOL_SIZE /**< Packets in the static pool. */
+#define DCC_SEQ_NONE            -1  /**< The packet has no client sequence number. */
+#define DCC_PREAMBLE_BITS       12  /**< Preamble ones sent ahead of each packet. */
+
+/** The bytes needed for a framed packet carrying the given number of data bytes. */
+#define DCC_FRAMED_SIZE(n)      ((DCC_PREAMBLE_BITS + (((n) + 1) * 9) + 1 + 7) / 8)
 
 #define T DCC_packet_T
 typedef struct T *T;
@@ -21,11 +32,18 @@ typedef struct T *T;
  *
  * This is a standard DCC packet, the number of bytes in which must be
  * compiled in.
+ *
+ * Packets are not allocated from the heap, but taken from a fixed pool
+ * sized for the scheduler queue, the refresh cache and the packets in
+ * flight, so creating and destroying them is cheap and safe to do from
+ * interrupt context.
  */
 struct T
 {
-    unsigned char *bytes;
+    unsigned char bytes[DCC_MAX_PACKET_SIZE];
     int size;
+    int seq;            /**< Client sequence number to acknowledge, or DCC_SEQ_NONE. */
+    uint16_t stamp;     /**< Scheduler clock when parsed, see Scheduler_now(). */
 };
 
 /**
@@ -39,14 +57,40 @@ extern T DCC_baseline_packet_create(void);
  * This function creates an empty DCC packet of specified size.
  *
  * The fresh DCC packet returned is initialised with all zeros.
+ *
+ * @return The new packet, or NULL if the size is too large or the
+ *  packet pool is exhausted.
  */
 extern T DCC_packet_create(int size);
 
 /**
- * Destroy a DCC packet created with <i>DCC_packet_create</i>.
+ * This function creates a packet from its data bytes.
+ *
+ * The data bytes are the address, instruction and any further data bytes,
+ * to which the preamble, the start bit before each byte, the XOR error
+ * detection byte and the packet end bit are added. The bit layout matches
+ * a baseline packet, so the address accessors work on framed packets and
+ * they may be cached and refreshed like any other.
+ *
+ * @param data The address, instruction and data bytes.
+ * @param size The number of data bytes.
+ *
+ * @return The new packet, or NULL if the framed packet is too large or the
+ *  packet pool is exhausted.
+ */
+extern T DCC_framed_packet_create(const unsigned char *data, int size);
+
+/**
+ * Return a DCC packet created with <i>DCC_packet_create</i> to the pool.
+ *
+ * A packet which is not from the pool, or has already been returned, is
+ * ignored rather than corrupting the pool.
  */
 extern void DCC_packet_destroy(T packet);
 
+/** Return the number of packets left in the pool. */
+extern int DCC_pool_report_free(void);
+
 /** 
  * Compare the speed of two DCC packets.
  *
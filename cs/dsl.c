@@ -9,46 +9,61 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <avr/pgmspace.h>
+#include <limits.h>
 
+#include "hal.h"
 #include "dsl.h"
+#include "dsl_kw.h"
+#include "io.h"
 
-#define T               DSL_result_T
-#define DSL_MAX_TOK_LEN 20
-#define DSL_TOK_FORWARD 128
-#define DSL_TOK_REVERSE 129
-#define DSL_TOK_STOP    130
-#define DSL_TOK_ADDR    131
-#define DSL_TOK_SPEED   132
-#define DSL_TOK_ALL     133
-#define DSL_TOK_NUMBER  134
-#define DSL_TOK_SHOW    135
-#define DSL_TOK_STATUS  136
-#define DSL_TOK_HELP    137
-#define DSL_TOK_RAW     138
-#define DSL_TOK_HEX     139
-#define DSL_TOK_CACHE   140
-#define DSL_TOK_CLEAR   141
-
-#define DSL_CMP(str, len, tok) ((len == strlen_P(PSTR(tok))) \
-                                && !strncmp_P(str, PSTR(tok), len))
+#define T                 DSL_result_T
+#define DSL_MAX_TOK_LEN   CONFIG_DSL_MAX_TOK_LEN
+#define DSL_MAX_TOKENS    8
+#define DSL_MAX_HEX_BYTES DCC_MAX_PACKET_SIZE
+
+_Static_assert(DSL_KW_MAX_LEN <= DSL_MAX_TOK_LEN,
+               "CONFIG_DSL_MAX_TOK_LEN is shorter than the longest keyword");
+
+/*
+ * Scanner states, which persist between calls to DSL_parser_feed.
+ */
+#define DSL_SCAN_IDLE     0     /**< Between tokens. */
+#define DSL_SCAN_ZERO     1     /**< Seen a leading zero, may be a hex prefix. */
+#define DSL_SCAN_HEX      2     /**< Inside a hexadecimal string. */
+#define DSL_SCAN_NUMBER   3     /**< Inside a decimal number. */
+#define DSL_SCAN_WORD     4     /**< Inside a keyword. */
+#define DSL_SCAN_ERROR    5     /**< Discarding input until end of line. */
+#define DSL_SCAN_TAG      6     /**< Inside a sequence number tag. */
 
 /**
  * Private module scanner.
  */
 static struct
 {
-    /* Flush the input. */
-    void (*flush)(void);
-
-    /* Semantic value of the scanned token. */
-    union {
-        int  i;
-        char s[DSL_MAX_TOK_LEN + 1];
-    } value;
-    
-    /* Flag to indicate last char was end of input. */
-    int seen_end;
+    /* Current scanner state. */
+    int state;
+
+    /* Keyword being scanned. */
+    char word[DSL_MAX_TOK_LEN + 1];
+    int word_len;
+
+    /* Number being scanned. */
+    int number;
+
+    /* Hexadecimal string, decoded into bytes a nibble at a time. */
+    unsigned char hex[DSL_MAX_HEX_BYTES];
+    int hex_nibbles;
+
+    /* Tokens scanned so far on this line and their semantic values. */
+    struct
+    {
+        int tok;
+        int value;
+    } tokens[DSL_MAX_TOKENS];
+    int count;
+
+    /* Semantic value of the current token. */
+    int value;
 } DSL_scanner;
 
 /**
@@ -58,6 +73,9 @@ static struct
 {
     int curr;
 
+    /* Index of the next token to be consumed by the parser. */
+    int next;
+
     /**
      * This variable stores the parser result object.
      */
@@ -70,7 +88,31 @@ static struct
 static void DSL_scanner_reset(void);
 
 /**
- * Scan the input stream until a token is found.
+ * Advance the scanner state machine by one character.
+ *
+ * @return 1 if the character ended the line, 0 otherwise.
+ */
+static int DSL_scanner_feed(int c);
+
+/**
+ * Append a completed token to the line, or flag an error if the
+ * token is unknown or there is no more room.
+ */
+static void DSL_scanner_emit(int tok, int value);
+
+/**
+ * Append a decimal digit to the number being scanned, saturating at
+ * INT_MAX rather than overflowing.
+ */
+static void DSL_scanner_digit(int c);
+
+/**
+ * Run the parser over the tokens of a completed line.
+ */
+static int DSL_parser_run(T result);
+
+/**
+ * Return the next token of the completed line.
  */
 static int DSL_next_token(void);
 
@@ -108,30 +150,83 @@ static int DSL_grammar_show(void);
 static int DSL_grammar_cache(void);
 static int DSL_grammar_help(void);
 static int DSL_grammar_raw(void);
+static int DSL_grammar_rawdata(void);
+static int DSL_grammar_mode(void);
+static int DSL_grammar_crc(void);
+static int DSL_grammar_trace(void);
 
 extern void
-DSL_module_init(void (*flush)(void))
+DSL_module_init(void)
 {
-    DSL_scanner.flush = flush;
+    DSL_scanner_reset();
 }
 
-extern int
-DSL_parser_start(T *result)
+extern void
+DSL_parser_reset(void)
 {
     DSL_scanner_reset();
+}
+
+extern int
+DSL_parser_seq(void)
+{
+    /* A tag can only be the first token. */
+    return ((DSL_scanner.count > 0 && DSL_scanner.tokens[0].tok == DSL_TOK_TAG)
+        ? DSL_scanner.tokens[0].value : DSL_SEQ_NONE);
+}
+
+extern int
+DSL_parser_feed(int c, T result)
+{
+    int status;
+
+    if(!DSL_scanner_feed(c))
+    {
+        /* The line is not yet complete. */
+        return DSL_PARSE_PENDING;
+    }
+
+    if(DSL_scanner.state == DSL_SCAN_ERROR)
+    {
+        status = DSL_PARSE_ERROR;
+    }
+    else if(DSL_scanner.count == 0)
+    {
+        status = DSL_PARSE_EMPTY;
+    }
+    else
+    {
+        status = DSL_parser_run(result);
+    }
 
     if(result != NULL)
     {
-        /* Create a new result object. */
-        *result = (T) malloc(sizeof(**result));
-        if(*result == NULL)
-        {
-            return DSL_PARSE_ERROR;
-        }
+        if(status != DSL_PARSE_OK)
+            result->type = DSL_RES_TYPE_UNDEF;
+
+        result->seq = DSL_parser_seq();
+
+        /* Packets carry the tag to the scheduler for acknowledgement. */
+        if(status == DSL_PARSE_OK && result->type != DSL_RES_TYPE_SYS)
+            result->payload.packet->seq = result->seq;
+    }
+
+    /* Get ready for the next line. */
+    DSL_scanner_reset();
 
-        /* Set the parser result object. */
-        DSL_parser.result = *result;
+    return status;
+}
+
+static int
+DSL_parser_run(T result)
+{
+    DSL_parser.next = 0;
+
+    /* Set the parser result object. */
+    if((DSL_parser.result = result) != NULL)
+    {
         DSL_parser.result->type = DSL_RES_TYPE_UNDEF;
+        DSL_parser.result->payload.packet = NULL;
     }
 
     /* Start the token stream for this parse. */
@@ -139,33 +234,26 @@ DSL_parser_start(T *result)
 
     if(DSL_parse() == DSL_PARSE_ERROR)
     {
-        /* Clear the input. */
-        DSL_scanner.flush();
-
-        /* Trash the result. */
+        /* Return any packet to the pool. */
         if(DSL_parser.result != NULL)
         {
             switch(DSL_parser.result->type)
             {
                 case DSL_RES_TYPE_RAW:
                 case DSL_RES_TYPE_DCC:
+                case DSL_RES_TYPE_DATA:
                     DCC_packet_destroy(DSL_parser.result->payload.packet);
                     break;
-
-                case DSL_RES_TYPE_SYS:
-                    Sys_cmd_destroy(DSL_parser.result->payload.cmd, NULL);
-                    break;
             }
 
-            free(DSL_parser.result);
-            *result = DSL_parser.result = NULL;
+            DSL_parser.result->type = DSL_RES_TYPE_UNDEF;
         }
 
         return DSL_PARSE_ERROR;
     }
 
     /* Finish off the packet. */
-    if(DSL_parser.result->type == DSL_RES_TYPE_DCC)
+    if(DSL_parser.result && DSL_parser.result->type == DSL_RES_TYPE_DCC)
     {
         DCC_set_checksum(DSL_parser.result->payload.packet);
         DCC_set_packet_end(DSL_parser.result->payload.packet);
@@ -177,187 +265,252 @@ DSL_parser_start(T *result)
 static void
 DSL_scanner_reset(void)
 {
-    DSL_scanner.seen_end = 0;
+    DSL_scanner.state = DSL_SCAN_IDLE;
+    DSL_scanner.count = 0;
 }
 
-static int
-DSL_next_token(void)
+static void
+DSL_scanner_emit(int tok, int value)
 {
-    char *tok;
-    int c, c2, tok_i = 0, num_i;
-
-    if(DSL_scanner.seen_end)
+    if(tok == DSL_TOK_END || DSL_scanner.count == DSL_MAX_TOKENS)
     {
-        return 0;
+        /* Unknown token or too many tokens for any command. */
+        DSL_scanner.state = DSL_SCAN_ERROR;
+        return;
     }
 
-    /* For convenience point tok to scanner value string buffer. */
-    tok = DSL_scanner.value.s;
+    DSL_scanner.tokens[DSL_scanner.count].tok = tok;
+    DSL_scanner.tokens[DSL_scanner.count++].value = value;
+    DSL_scanner.state = DSL_SCAN_IDLE;
+}
 
-    /* Start scanning characters until we find a token. */
-    for(;;)
-    {
-        c = getchar();
+static void
+DSL_scanner_digit(int c)
+{
+    if(DSL_scanner.number > (INT_MAX - (c - '0')) / 10)
+        DSL_scanner.number = INT_MAX;
+    else
+        DSL_scanner.number = (DSL_scanner.number * 10) + (c - '0');
+}
 
-        /* Scan for hexadecimal token. */
-        if(isdigit(c) && c == '0')
-        {
-            if(isalpha(c2 = getchar()) && c2 == 'x')
+static int
+DSL_scanner_feed(int c)
+{
+    int nibble;
+
+    /*
+     * Continue the token in progress, or complete it if this
+     * character cannot be part of it.
+     */
+    switch(DSL_scanner.state)
+    {
+        case DSL_SCAN_ZERO:
+            if(c == 'x' || c == 'X')
             {
                 /* This is definately a hexadecimal string. */
-                while((tok_i < DSL_MAX_TOK_LEN)
-                    && (isalpha(c = getchar()) || isdigit(c)))
-                {
-                    tok[tok_i++] = (isdigit(c) ? c : toupper(c));
-                }
-
-                tok[tok_i] = '\0';
-
-                /* Now check that this hex string has an even number of characters. */
-                if(strlen(tok) > 0 && (strlen(tok) % 2) != 0)
-                {
-                    /* Zero or odd number of characters. */
-                    return 0;
-                }
-
-                if(c < 0)
-                {
-                    DSL_scanner.seen_end = 1;
-                }
-                else
-                {
-                    ungetc(c, stdin);
-                }
-
-                return DSL_TOK_HEX;
+                DSL_scanner.hex_nibbles = 0;
+                DSL_scanner.state = DSL_SCAN_HEX;
+                return 0;
             }
-            else
+            else if(isdigit(c))
             {
-                ungetc(c2, stdin);
+                DSL_scanner.number = (c - '0');
+                DSL_scanner.state = DSL_SCAN_NUMBER;
+                return 0;
             }
-        }
 
-        /* Scan for numbers. */
-        if(isdigit(c))
-        {
-            for(num_i = (c - '0'); isdigit(c = getchar()); )
+            DSL_scanner_emit(DSL_TOK_NUMBER, 0);
+            break;
+
+        case DSL_SCAN_NUMBER:
+            if(isdigit(c))
             {
-                num_i = (num_i * 10) + (c - '0');
+                DSL_scanner_digit(c);
+                return 0;
             }
 
-            /* Set the semantic value for this number token. */
-            DSL_scanner.value.i = num_i;
+            DSL_scanner_emit(DSL_TOK_NUMBER, DSL_scanner.number);
+            break;
 
-            if(c < 0)
+        case DSL_SCAN_TAG:
+            if(isdigit(c))
             {
-                DSL_scanner.seen_end = 1;
+                DSL_scanner_digit(c);
+                DSL_scanner.word_len++;
+                return 0;
             }
-            else
+
+            if(DSL_scanner.word_len == 0)
             {
-                ungetc(c, stdin);
+                /* A hash with no digits. */
+                DSL_scanner.state = DSL_SCAN_ERROR;
+                break;
             }
 
-            return DSL_TOK_NUMBER;
-        }
+            DSL_scanner_emit(DSL_TOK_TAG, DSL_scanner.number);
+            break;
 
-        /* Scan for keywords. */
-        if(isalpha(c))
-        {
-            do
+        case DSL_SCAN_HEX:
+            if(isxdigit(c))
             {
-                tok[tok_i++] = tolower(c);
-            }
-            while(isalpha(c = getchar()) && tok_i < DSL_MAX_TOK_LEN);
+                if(DSL_scanner.hex_nibbles == (DSL_MAX_HEX_BYTES * 2))
+                {
+                    DSL_scanner.state = DSL_SCAN_ERROR;
+                    return 0;
+                }
 
-            if(c < 0)
-            {
-                DSL_scanner.seen_end = 1;
-            }
-            else
-            {
-                ungetc(c, stdin);
-            }
+                nibble = (isdigit(c) ? (c - '0') : (tolower(c) - 'a' + 10));
+                if((DSL_scanner.hex_nibbles % 2) == 0)
+                {
+                    DSL_scanner.hex[DSL_scanner.hex_nibbles / 2] = (nibble << 4);
+                }
+                else
+                {
+                    DSL_scanner.hex[DSL_scanner.hex_nibbles / 2] |= nibble;
+                }
 
-            if(DSL_CMP(tok, tok_i, "raw"))
-            {
-                return DSL_TOK_RAW;
-            }
-            else if(DSL_CMP(tok, tok_i, "forward") || DSL_CMP(tok, tok_i, "fw"))
-            {
-                return DSL_TOK_FORWARD;
-            }
-            else if(DSL_CMP(tok, tok_i, "reverse") || DSL_CMP(tok, tok_i, "rv"))
-            {
-                return DSL_TOK_REVERSE;
-            }
-            else if(DSL_CMP(tok, tok_i, "stop"))
-            {
-                return DSL_TOK_STOP;
-            }
-            else if(DSL_CMP(tok, tok_i, "addr") || DSL_CMP(tok, tok_i, "ad"))
-            {
-                return DSL_TOK_ADDR;
-            }
-            else if(DSL_CMP(tok, tok_i, "speed") || DSL_CMP(tok, tok_i, "sp"))
-            {
-                return DSL_TOK_SPEED;
-            }
-            else if(DSL_CMP(tok, tok_i, "all"))
-            {
-                return DSL_TOK_ALL;
-            }
-            else if(DSL_CMP(tok, tok_i, "show"))
-            {
-                return DSL_TOK_SHOW;
-            }
-            else if(DSL_CMP(tok, tok_i, "cache"))
-            {
-                return DSL_TOK_CACHE;
-            }
-            else if(DSL_CMP(tok, tok_i, "clear"))
-            {
-                return DSL_TOK_CLEAR;
-            }
-            else if(DSL_CMP(tok, tok_i, "status"))
-            {
-                return DSL_TOK_STATUS;
+                DSL_scanner.hex_nibbles++;
+                return 0;
             }
-            else if(DSL_CMP(tok, tok_i, "help"))
+
+            if(DSL_scanner.hex_nibbles == 0 || (DSL_scanner.hex_nibbles % 2) != 0)
             {
-                return DSL_TOK_HELP;
+                /* Zero or odd number of characters. */
+                DSL_scanner.state = DSL_SCAN_ERROR;
+                break;
             }
-            else
+
+            /* The semantic value is the number of bytes. */
+            DSL_scanner_emit(DSL_TOK_HEX, DSL_scanner.hex_nibbles / 2);
+            break;
+
+        case DSL_SCAN_WORD:
+            if(isalpha(c))
             {
-                /* Unknown token. */
+                if(DSL_scanner.word_len == DSL_MAX_TOK_LEN)
+                {
+                    DSL_scanner.state = DSL_SCAN_ERROR;
+                    return 0;
+                }
+
+                DSL_scanner.word[DSL_scanner.word_len++] = tolower(c);
                 return 0;
             }
-        }
 
-        /* Process remaining characters. */
+            /* Returns 0 for an unknown token. */
+            DSL_scanner_emit(DSL_kw_lookup(DSL_scanner.word,
+                DSL_scanner.word_len), 0);
+            break;
+    }
+
+    if(c == '\n' || c == ';')
+    {
+        /* End of command. */
+        return 1;
+    }
+
+    if(DSL_scanner.state == DSL_SCAN_ERROR)
+    {
+        /* Discard the rest of the line. */
+        return 0;
+    }
+
+    /* Start scanning a new token. */
+    if(c == '0')
+    {
+        DSL_scanner.state = DSL_SCAN_ZERO;
+    }
+    else if(isdigit(c))
+    {
+        DSL_scanner.number = (c - '0');
+        DSL_scanner.state = DSL_SCAN_NUMBER;
+    }
+    else if(isalpha(c))
+    {
+        DSL_scanner.word[0] = tolower(c);
+        DSL_scanner.word_len = 1;
+        DSL_scanner.state = DSL_SCAN_WORD;
+    }
+    else if(c == '#')
+    {
+        /* The digit count is kept in word_len. */
+        DSL_scanner.number = 0;
+        DSL_scanner.word_len = 0;
+        DSL_scanner.state = DSL_SCAN_TAG;
+    }
+    else
+    {
         switch(c)
         {
             case ' ':
             case '\t':
+            case '\r':
                 /* Ignore whitespace. */
+                DSL_scanner.state = DSL_SCAN_IDLE;
                 break;
 
             default:
                 /* Unknown character. */
-                return 0;
+                DSL_scanner.state = DSL_SCAN_ERROR;
+                break;
         }
     }
+
+    return 0;
+}
+
+static int
+DSL_next_token(void)
+{
+    if(DSL_parser.next >= DSL_scanner.count)
+    {
+        /* No more tokens on this line. */
+        return DSL_TOK_END;
+    }
+
+    DSL_scanner.value = DSL_scanner.tokens[DSL_parser.next].value;
+
+    return DSL_scanner.tokens[DSL_parser.next++].tok;
 }
 
 static int
 DSL_parse(void)
 {
-    if(!(DSL_grammar_raw()
-        || DSL_grammar_help()
-        || DSL_grammar_show()
-        || DSL_grammar_cache()
-        || DSL_grammar_forward()
-        || DSL_grammar_reverse()
-        || DSL_grammar_stop()))
+    int status;
+
+    /* The optional tag has already been recorded by the scanner. */
+    DSL_accept(DSL_TOK_TAG);
+
+    /*
+     * Each command starts with its own keyword, so choose the grammar by
+     * it. Trying each grammar in turn would let one that failed part way
+     * through leave its tokens, and any packet it allocated, to the next.
+     */
+    switch(DSL_parser.curr)
+    {
+        case DSL_TOK_RAW:       status = DSL_grammar_raw();      break;
+        case DSL_TOK_RAWDATA:   status = DSL_grammar_rawdata();  break;
+        case DSL_TOK_HELP:      status = DSL_grammar_help();     break;
+        case DSL_TOK_SHOW:      status = DSL_grammar_show();     break;
+        case DSL_TOK_CACHE:     status = DSL_grammar_cache();    break;
+        case DSL_TOK_MODE:      status = DSL_grammar_mode();     break;
+        case DSL_TOK_CRC:       status = DSL_grammar_crc();      break;
+        case DSL_TOK_TRACE:     status = DSL_grammar_trace();    break;
+        case DSL_TOK_FORWARD:   status = DSL_grammar_forward();  break;
+        case DSL_TOK_REVERSE:   status = DSL_grammar_reverse();  break;
+        case DSL_TOK_STOP:      status = DSL_grammar_stop();     break;
+
+        default:
+            return DSL_PARSE_ERROR;
+    }
+
+    if(status == DSL_PARSE_ERROR)
+    {
+        return DSL_PARSE_ERROR;
+    }
+
+    /* The command must account for the whole line. */
+    if(!DSL_accept_no_advance(DSL_TOK_END))
     {
         return DSL_PARSE_ERROR;
     }
@@ -398,7 +551,7 @@ DSL_grammar_help(void)
         if(DSL_parser.result)
         {
             DSL_parser.result->type = DSL_RES_TYPE_SYS;
-            DSL_parser.result->payload.cmd = Sys_cmd_create(SYS_CMD_TYPE_HELP, NULL);
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, SYS_CMD_TYPE_HELP, 0);
         }
 
         /* Help command has no arguments. */
@@ -420,16 +573,147 @@ DSL_grammar_show(void)
         {
             case DSL_TOK_STATUS:
                 cmd_type = SYS_CMD_TYPE_STATUS;
+                DSL_advance();
+                break;
+
+            case DSL_TOK_TIMING:
+                cmd_type = SYS_CMD_TYPE_TIMING;
+                DSL_advance();
+                break;
+
+            case DSL_TOK_BANDWIDTH:
+                cmd_type = SYS_CMD_TYPE_BANDWIDTH;
+                DSL_advance();
+                break;
+
+            case DSL_TOK_LATENCY:
+                cmd_type = SYS_CMD_TYPE_LATENCY;
+                DSL_advance();
+                break;
+
+            case DSL_TOK_TRACE:
+                cmd_type = SYS_CMD_TYPE_TRACE_SHOW;
+                DSL_advance();
+                break;
+
+            case DSL_TOK_LOCOS:
+                cmd_type = SYS_CMD_TYPE_LOCOS;
+                DSL_advance();
+                break;
+
+            default:
+                return DSL_PARSE_ERROR;
+        }
+
+        if(DSL_parser.result)
+        {
+            DSL_parser.result->type = DSL_RES_TYPE_SYS;
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, cmd_type, 0);
+        }
+
+        return DSL_PARSE_OK;
+    }
+
+    return DSL_PARSE_ERROR;
+}
+
+static int
+DSL_grammar_mode(void)
+{
+    int mode;
+
+    if(DSL_accept(DSL_TOK_MODE))
+    {
+        switch(DSL_parser.curr)
+        {
+            case DSL_TOK_MACHINE:
+                mode = IO_MODE_MACHINE;
+                break;
+
+            case DSL_TOK_HUMAN:
+                mode = IO_MODE_HUMAN;
+                break;
+
+            default:
+                return DSL_PARSE_ERROR;
+        }
+
+        DSL_advance();
+
+        if(DSL_parser.result)
+        {
+            DSL_parser.result->type = DSL_RES_TYPE_SYS;
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, SYS_CMD_TYPE_MODE, mode);
+        }
+
+        return DSL_PARSE_OK;
+    }
+
+    return DSL_PARSE_ERROR;
+}
+
+static int
+DSL_grammar_crc(void)
+{
+    int enable;
+
+    if(DSL_accept(DSL_TOK_CRC))
+    {
+        switch(DSL_parser.curr)
+        {
+            case DSL_TOK_ON:
+                enable = 1;
+                break;
+
+            case DSL_TOK_OFF:
+                enable = 0;
                 break;
 
             default:
                 return DSL_PARSE_ERROR;
         }
 
+        DSL_advance();
+
+        if(DSL_parser.result)
+        {
+            DSL_parser.result->type = DSL_RES_TYPE_SYS;
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, SYS_CMD_TYPE_CRC, enable);
+        }
+
+        return DSL_PARSE_OK;
+    }
+
+    return DSL_PARSE_ERROR;
+}
+
+static int
+DSL_grammar_trace(void)
+{
+    int enable;
+
+    if(DSL_accept(DSL_TOK_TRACE))
+    {
+        switch(DSL_parser.curr)
+        {
+            case DSL_TOK_ON:
+                enable = 1;
+                break;
+
+            case DSL_TOK_OFF:
+                enable = 0;
+                break;
+
+            default:
+                return DSL_PARSE_ERROR;
+        }
+
+        DSL_advance();
+
         if(DSL_parser.result)
         {
             DSL_parser.result->type = DSL_RES_TYPE_SYS;
-            DSL_parser.result->payload.cmd = Sys_cmd_create(cmd_type, NULL);
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, SYS_CMD_TYPE_TRACE, enable);
         }
 
         return DSL_PARSE_OK;
@@ -442,8 +726,7 @@ static int
 DSL_grammar_cache(void)
 {
     uint8_t cmd_type = 0;
-    int *address;
-    void *args = NULL;
+    int address = 0;
 
     if(DSL_accept(DSL_TOK_CACHE))
     {
@@ -451,6 +734,7 @@ DSL_grammar_cache(void)
         {
             case DSL_TOK_CLEAR:
                 cmd_type = SYS_CMD_TYPE_CACHE_CLEAR;
+                DSL_advance();
                 break;
 
             case DSL_TOK_SHOW:
@@ -458,9 +742,8 @@ DSL_grammar_cache(void)
                 if(DSL_accept_no_advance(DSL_TOK_NUMBER))
                 {
                     cmd_type = SYS_CMD_TYPE_CACHE_SHOW;
-                    address = (int*) malloc(sizeof(int));
-                    *address = DSL_scanner.value.i;
-                    args = (void*) address;
+                    address = DSL_scanner.value;
+                    DSL_advance();
                 }
                 else
                 {
@@ -476,7 +759,7 @@ DSL_grammar_cache(void)
         if(DSL_parser.result)
         {
             DSL_parser.result->type = DSL_RES_TYPE_SYS;
-            DSL_parser.result->payload.cmd = Sys_cmd_create(cmd_type, args);
+            Sys_cmd_init(&DSL_parser.result->payload.cmd, cmd_type, address);
         }
 
         return DSL_PARSE_OK;
@@ -495,6 +778,11 @@ DSL_grammar_forward(void)
         {
             DSL_parser.result->type = DSL_RES_TYPE_DCC;
             DSL_parser.result->payload.packet = DCC_baseline_packet_create();
+            if(DSL_parser.result->payload.packet == NULL)
+            {
+                /* The packet pool is exhausted. */
+                return DSL_PARSE_ERROR;
+            }
         }
 
         if((DSL_grammar_addr() && DSL_grammar_speed())
@@ -526,6 +814,11 @@ DSL_grammar_reverse(void)
         {
             DSL_parser.result->type = DSL_RES_TYPE_DCC;
             DSL_parser.result->payload.packet = DCC_baseline_packet_create();
+            if(DSL_parser.result->payload.packet == NULL)
+            {
+                /* The packet pool is exhausted. */
+                return DSL_PARSE_ERROR;
+            }
         }
 
         if((DSL_grammar_addr() && DSL_grammar_speed())
@@ -557,12 +850,21 @@ DSL_grammar_stop(void)
         {
             DSL_parser.result->type = DSL_RES_TYPE_DCC;
             DSL_parser.result->payload.packet = DCC_baseline_packet_create();
+            if(DSL_parser.result->payload.packet == NULL)
+            {
+                /* The packet pool is exhausted. */
+                return DSL_PARSE_ERROR;
+            }
+
             DCC_set_preamble(DSL_parser.result->payload.packet);
         }
 
-        /* Address is optional. */
-        if(DSL_grammar_addr())
+        /* Address is optional, but must be complete if given. */
+        if(DSL_accept_no_advance(DSL_TOK_ADDR))
         {
+            if(!DSL_grammar_addr())
+                return DSL_PARSE_ERROR;
+
             /* Semantic action for specific loco. */
             if(DSL_parser.result && DSL_parser.result->payload.packet)
             {
@@ -611,7 +913,7 @@ DSL_grammar_addr(void)
         if(DSL_parser.result && DSL_parser.result->payload.packet)
         {
             DCC_set_address(DSL_parser.result->payload.packet,
-                (unsigned char) DSL_scanner.value.i);
+                (unsigned char) DSL_scanner.value);
         }
 
         DSL_advance();
@@ -638,7 +940,7 @@ DSL_grammar_speed(void)
         if(DSL_parser.result && DSL_parser.result->payload.packet)
         {
             DCC_set_speed(DSL_parser.result->payload.packet,
-                (unsigned char) DSL_scanner.value.i);
+                (unsigned char) DSL_scanner.value);
         }
 
         DSL_advance();
@@ -654,22 +956,52 @@ DSL_grammar_speed(void)
 static int
 DSL_grammar_raw(void)
 {
-    int i;
-
     if(DSL_accept(DSL_TOK_RAW) && DSL_accept_no_advance(DSL_TOK_HEX))
     {
         /* Semantic action. */
-        if(DSL_parser.result && DSL_parser.result->payload.packet)
+        if(DSL_parser.result)
         {
-            /* Setup result. */
+            /* Setup result, the hex bytes were decoded by the scanner. */
             DSL_parser.result->type = DSL_RES_TYPE_RAW;
-            DSL_parser.result->payload.packet = DCC_packet_create(strlen(DSL_scanner.value.s) / 2);
+            DSL_parser.result->payload.packet = DCC_packet_create(DSL_scanner.value);
+            if(DSL_parser.result->payload.packet == NULL)
+            {
+                return DSL_PARSE_ERROR;
+            }
 
-            /* Convert hexadecimal string into array of bytes and populate packet. */
-            for(i=0; i < (strlen(DSL_scanner.value.s) / 2); i++)
+            memcpy(DSL_parser.result->payload.packet->bytes, DSL_scanner.hex,
+                DSL_scanner.value);
+        }
+
+        DSL_advance();
+
+        return DSL_PARSE_OK;
+    }
+
+    return DSL_PARSE_ERROR;
+}
+
+static int
+DSL_grammar_rawdata(void)
+{
+    if(DSL_accept(DSL_TOK_RAWDATA) && DSL_accept_no_advance(DSL_TOK_HEX))
+    {
+        /* Reject data too long to frame, even when only checking syntax. */
+        if(DCC_FRAMED_SIZE(DSL_scanner.value) > DCC_MAX_PACKET_SIZE)
+        {
+            return DSL_PARSE_ERROR;
+        }
+
+        /* Semantic action. */
+        if(DSL_parser.result)
+        {
+            /* The packet is framed from the address, instruction & data bytes. */
+            DSL_parser.result->type = DSL_RES_TYPE_DATA;
+            DSL_parser.result->payload.packet = DCC_framed_packet_create(
+                DSL_scanner.hex, DSL_scanner.value);
+            if(DSL_parser.result->payload.packet == NULL)
             {
-                sscanf(DSL_scanner.value.s + (i * 2), "%2hhx",
-                    &DSL_parser.result->payload.packet->bytes[i]);
+                return DSL_PARSE_ERROR;
             }
         }
 
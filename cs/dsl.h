@@ -8,15 +8,29 @@
  * parser expects a human-readable domain specific language (DSL) syntax,
  * which at current, constructs the equivalent DCC packet.
  *
+ * Input is pushed into the module one character at a time as it arrives.
+ * The scanner is a state machine which keeps its state between calls and
+ * queues the tokens of the current line, so feeding a character never
+ * blocks. When a line is terminated (by a newline or semicolon), the
+ * parser runs over the queued tokens and the finished result is returned.
+ *
  * This scanner/parser module is handwritten (as opposed to generated) to
  * achieve the speed and compactness required by embedded environments.
  *
  * The grammar is as follows (in BNF form, terminals uppercase):
  *
  * @code
+ * line : TAG command
+ *      | command
+ *      ;
+ *
  * command : raw
+ *         | rawdata
  *         | show
  *         | cache
+ *         | mode
+ *         | crc
+ *         | trace
  *         | forward
  *         | reverse
  *         | stop
@@ -25,7 +39,15 @@
  * raw : RAW HEX
  *     ;
  *
+ * rawdata : RAWDATA HEX
+ *         ;
+ *
  * show : SHOW STATUS
+ *      | SHOW TIMING
+ *      | SHOW BANDWIDTH
+ *      | SHOW LATENCY
+ *      | SHOW TRACE
+ *      | SHOW LOCOS
  *      ;
  *
  * cache : CACHE CLEAR
@@ -51,7 +73,23 @@
  *
  * help : HELP
  *      ;
+ *
+ * mode : MODE MACHINE
+ *      | MODE HUMAN
+ *      ;
+ *
+ * crc : CRC ON
+ *     | CRC OFF
+ *     ;
+ *
+ * trace : TRACE ON
+ *       | TRACE OFF
+ *       ;
  * @endcode
+ *
+ * A TAG is a client sequence number written as a hash followed by a
+ * decimal number (e.g. "#12 stop addr 3"), which is echoed back in the
+ * reply to the command.
  */
 
 #ifndef DSL_INCLUDED
@@ -67,57 +105,113 @@
 #define DSL_RES_TYPE_DCC   1
 #define DSL_RES_TYPE_SYS   2
 #define DSL_RES_TYPE_RAW   3
+#define DSL_RES_TYPE_DATA  4
 #define DSL_PARSE_OK       1
 #define DSL_PARSE_ERROR    0
+#define DSL_PARSE_PENDING  2
+#define DSL_PARSE_EMPTY    3
+
+/*
+ * Token codes returned by the scanner. Keyword tokens are mapped from
+ * their spelling by the generated table in dsl_kw.h (see kwgen.c).
+ */
+#define DSL_TOK_END        0
+#define DSL_TOK_FORWARD    128
+#define DSL_TOK_REVERSE    129
+#define DSL_TOK_STOP       130
+#define DSL_TOK_ADDR       131
+#define DSL_TOK_SPEED      132
+#define DSL_TOK_ALL        133
+#define DSL_TOK_NUMBER     134
+#define DSL_TOK_SHOW       135
+#define DSL_TOK_STATUS     136
+#define DSL_TOK_HELP       137
+#define DSL_TOK_RAW        138
+#define DSL_TOK_HEX        139
+#define DSL_TOK_CACHE      140
+#define DSL_TOK_CLEAR      141
+#define DSL_TOK_MODE       142
+#define DSL_TOK_MACHINE    143
+#define DSL_TOK_HUMAN      144
+#define DSL_TOK_TAG        145
+#define DSL_TOK_CRC        146
+#define DSL_TOK_ON         147
+#define DSL_TOK_OFF        148
+#define DSL_TOK_RAWDATA    149
+#define DSL_TOK_TIMING     150
+#define DSL_TOK_BANDWIDTH  151
+#define DSL_TOK_LATENCY    152
+#define DSL_TOK_TRACE      153
+#define DSL_TOK_LOCOS      154
+
+#define DSL_SEQ_NONE       DCC_SEQ_NONE
 
 /**
  * Structure to allow for arbitrary return types from the parser. The
  * type field determines which union member to use to access the data.
+ *
+ * The structure is owned by the caller and system commands are held
+ * inline, so parsing a command does not touch the heap. DCC packets are
+ * taken from the DCC packet pool.
  */
 typedef struct T *T;
 struct T
 {
     int type;
+    int seq;    /**< The client sequence number, or DSL_SEQ_NONE. */
     union
     {
         DCC_packet_T packet;
-        Sys_cmd_T cmd;
+        struct Sys_cmd_T cmd;
     } payload;
 };
 
 /**
  * Initialise the DSL module internals.
+ */
+extern void DSL_module_init(void);
+
+/**
+ * Discard any partially scanned line.
  *
- * This function in particular sets the character stream handling
- * functions used by the token scanner. These callbacks should
- * operate on the same input character stream. They allow the calling
- * context to define where the character stream is coming from, and how
- * to manage it (e.g. designed to work with embedded environments in
- * particular.
+ * This should be called when the input stream is known to be corrupt
+ * (e.g. a USART framing error), so the next character starts a new line.
+ */
+extern void DSL_parser_reset(void);
+
+/**
+ * Return the sequence number tag of the partially scanned line.
  *
- * @param flush The callback to flush the IO buffers
+ * @return The tag, or DSL_SEQ_NONE if the line has not started with one.
  */
-extern void DSL_module_init(void (*flush)(void));
+extern int DSL_parser_seq(void);
 
 /**
- * Start parsing the input stream.
+ * Push the next input character into the scanner and parser.
+ *
+ * Characters are consumed until the end of the line, at which point the
+ * whole line is parsed and:
  *
- * This function instructs the parser module to start processing the input
- * character stream until:
+ * - a valid command is returned, or
+ * - a syntax error is reported
  *
- * - a valid command is parsed, or
- * - a syntax error is encountered
+ * Once a line contains an error, the rest of it is discarded without
+ * further scanning.
  *
- * The argument should be a pointer to a pointer to a DSL result object. The
- * object will be created and initialised if the pointer to the pointer is
- * not NULL. If it is NULL, then the parser will essentially just perform
- * a syntax check.
+ * The result argument should point to a caller provided DSL result object,
+ * which is filled in when a line is parsed successfully. The sequence
+ * number is also set for lines with errors, if the tag itself was
+ * readable, so the client can be told which command failed. If it is NULL,
+ * then the parser will essentially just perform a syntax check.
  *
- * @param packet A pointer to a DSL result object pointer.
+ * @param c The next input character.
+ * @param result A pointer to a DSL result object.
  *
- * @return 1 if the stream is parsed with no problems, 0 otherwise.
+ * @return DSL_PARSE_PENDING if the line is not yet complete, DSL_PARSE_OK
+ *  if a line is parsed with no problems, DSL_PARSE_EMPTY for a blank line
+ *  and DSL_PARSE_ERROR otherwise.
  */
-extern int DSL_parser_start(T *result);
+extern int DSL_parser_feed(int c, T result);
 
 #undef T
 #endif
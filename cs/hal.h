@@ -0,0 +1,101 @@
+/**
+ * @file hal.h
+ * @brief Defines the hardware abstraction layer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The modules reach the microcontroller only through this header, so the
+ * firmware can be built either for the target or natively on a host. The
+ * backend is chosen at build time:
+ *
+ * - hal_avr.h, the ATmega target (the default).
+ * - hal_posix.h, a simulation on a POSIX host, selected by defining
+ *   HAL_POSIX (see make native).
+ *
+ * Each backend provides the following, as macros or inline functions
+ * where the target needs them to cost nothing over direct register use:
+ *
+ * - Interrupt masking: HAL_IRQ_DISABLE(), HAL_IRQ_ENABLE() and the
+ *   HAL_ATOMIC_BLOCK statement, which restores the previous state.
+ * - Interrupt handlers: HAL_ISR(vector), for HAL_VECT_SCHEDULER,
+ *   HAL_VECT_SIGNAL and HAL_VECT_USART_RX.
+ * - Flash strings: avr-libc's PROGMEM, PGM_P, PSTR(), printf_P(),
+ *   pgm_read_byte(), pgm_read_word() and strncmp_P(), along with
+ *   HAL_PGM_READ_PTR() to read an entry of a table of flash strings.
+ * - The scheduler timer: Hal_scheduler_timer_init(), which interrupts every
+ *   (top + 1) * HAL_SCHEDULER_PRESCALE cpu cycles, HAL_SCHEDULER_COUNT()
+ *   and HAL_SCHEDULER_PENDING() for a compare match not yet handled.
+ * - The signal timer: Hal_signal_timer_init(), Hal_signal_timer_start(),
+ *   HAL_SIGNAL_SET_PERIOD(cycles), which toggles the output every period,
+ *   and HAL_SIGNAL_IS_HIGH().
+ * - The timing counter: Hal_timing_timer_init(), HAL_TIMING_START(),
+ *   HAL_TIMING_COUNT() in units of HAL_TIMING_PRESCALE cycles and
+ *   HAL_TIMING_OVERFLOW().
+ * - The USART: Hal_usart_init(baud), HAL_USART_RX_STATUS(), which must be
+ *   read before HAL_USART_RX_DATA(), HAL_USART_RX_FAILED(status) and
+ *   HAL_USART_PUTC(c).
+ * - GPIO: HAL_LED_ON(led) and HAL_LED_OFF(led) for HAL_LED1 and HAL_LED2.
+ * - HAL_DELAY_MS(ms), and HAL_IDLE() which the main loop calls on every
+ *   pass.
+ */
+
+#ifndef HAL_DEFINED
+#define HAL_DEFINED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+#ifdef HAL_POSIX
+#include "hal_posix.h"
+#else
+#include "hal_avr.h"
+#endif
+
+/**
+ * Memory usage, in bytes. Every field is zero where the backend cannot
+ * measure it.
+ */
+struct Hal_mem
+{
+    unsigned total;         /**< RAM size. */
+    unsigned free;          /**< Between the heap and the stack, now. */
+    unsigned stack_max;     /**< Deepest the stack has reached. */
+    unsigned heap_max;      /**< Highest the heap has reached. */
+    unsigned heap_largest;  /**< Largest block malloc could return. */
+    unsigned free_min;      /**< Least free memory there has been. */
+};
+
+/**
+ * Prepare the backend, before any module is initialised.
+ *
+ * @param argc The argument count passed to main.
+ * @param argv The arguments passed to main, used by host backends.
+ */
+extern void Hal_init(int argc, char **argv);
+
+/**
+ * Open a write only stdio stream on a character output function.
+ *
+ * @param put Called for every character written to the stream.
+ *
+ * @return The stream.
+ */
+extern FILE *Hal_stream_open(int (*put)(char, FILE *));
+
+/**
+ * Note the heap break after an allocation, to track the heap high water
+ * mark.
+ */
+extern void Hal_heap_note(void);
+
+/**
+ * Measure the memory usage.
+ *
+ * @param mem Filled in with the current usage and high water marks.
+ */
+extern void Hal_mem_report(struct Hal_mem *mem);
+
+#endif
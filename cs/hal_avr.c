@@ -0,0 +1,165 @@
+/**
+ * @file hal_avr.c
+ * @brief Implements the ATmega backend of the hardware abstraction layer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/version.h>
+
+#include "hal.h"
+
+#if (RAMEND - RAMSTART + 1) != CONFIG_RAM_SIZE
+#error "CONFIG_RAM_SIZE does not match the MCU, check the build profile"
+#endif
+
+#define HAL_STACK_PAINT 0xC5    /**< Painted over free memory at boot. */
+
+/*
+ * Memory layout symbols from the linker and avr-libc's malloc.
+ */
+extern uint8_t __stack;
+extern uint8_t __heap_start;
+extern char *__brkval;
+extern size_t __malloc_margin;
+
+/*
+ * The malloc free list is private to avr-libc, declared here as in its
+ * stdlib_private.h. The layout has not changed from 1.4 to 2.2, newer
+ * releases must be checked against their sources before being allowed.
+ */
+#if __AVR_LIBC_VERSION__ < 10400UL || __AVR_LIBC_VERSION__ >= 20300UL
+#error "Check struct __freelist against this avr-libc's stdlib_private.h"
+#endif
+
+/**
+ * The avr-libc malloc free list entry.
+ */
+struct __freelist
+{
+    size_t sz;
+    struct __freelist *nx;
+};
+
+extern struct __freelist *__flp;
+
+static FILE Hal_stream;
+
+/**
+ * The highest break the heap has reached.
+ */
+static char *Hal_heap_brk_max;
+
+static size_t Hal_heap_largest_free(void);
+static uint8_t *Hal_stack_low_water(char *heap_max);
+
+/**
+ * Paint the memory between the static data and the top of the stack
+ * before anything runs, so the deepest stack use can later be found.
+ * This runs in .init1, before the stack pointer and zero register are
+ * set up, so it must not touch either.
+ */
+void Hal_paint_stack(void) __attribute__ ((naked, used, section(".init1")));
+
+void
+Hal_paint_stack(void)
+{
+    __asm volatile (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:\n"
+        "    st Z+, r24\n"
+        "2:\n"
+        "    cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+        :: "i" (HAL_STACK_PAINT)
+    );
+}
+
+extern void
+Hal_init(int argc, char **argv)
+{
+}
+
+extern FILE *
+Hal_stream_open(int (*put)(char, FILE *))
+{
+    fdev_setup_stream(&Hal_stream, put, NULL, _FDEV_SETUP_WRITE);
+
+    return &Hal_stream;
+}
+
+extern void
+Hal_heap_note(void)
+{
+    if(__brkval > Hal_heap_brk_max)
+        Hal_heap_brk_max = __brkval;
+}
+
+extern void
+Hal_mem_report(struct Hal_mem *mem)
+{
+    uint8_t *stack_low;
+    char *heap_max, *brk;
+    int v;
+
+    /* The deepest the stack has reached, and the highest the heap has. */
+    heap_max = (Hal_heap_brk_max == NULL ? (char *) &__heap_start : Hal_heap_brk_max);
+    stack_low = Hal_stack_low_water(heap_max);
+    brk = (__brkval == NULL ? (char *) &__heap_start : __brkval);
+
+    mem->total = CONFIG_RAM_SIZE;
+    mem->free = (char *) &v - brk;
+    mem->stack_max = &__stack - stack_low + 1;
+    mem->heap_max = heap_max - (char *) &__heap_start;
+    mem->heap_largest = Hal_heap_largest_free();
+    mem->free_min = (char *) stack_low - heap_max;
+}
+
+/**
+ * Find the lowest address the stack has reached, by scanning up from the
+ * highest heap break for the first byte which is no longer painted.
+ */
+static uint8_t *
+Hal_stack_low_water(char *heap_max)
+{
+    uint8_t *p = (uint8_t *) heap_max;
+
+    while(p <= &__stack && *p == HAL_STACK_PAINT)
+        p++;
+
+    return p;
+}
+
+/**
+ * Find the largest block malloc could return, from either the free list or
+ * the unused space between the heap and the stack.
+ */
+static size_t
+Hal_heap_largest_free(void)
+{
+    struct __freelist *fp;
+    size_t largest = 0;
+    char *brk, *top;
+
+    for(fp = __flp; fp != NULL; fp = fp->nx)
+    {
+        if(fp->sz > largest)
+            largest = fp->sz;
+    }
+
+    /* Malloc keeps a margin below the stack pointer. */
+    brk = (__brkval == NULL ? (char *) &__heap_start : __brkval);
+    top = (char *) SP - __malloc_margin;
+    if(top > brk && (size_t) (top - brk) > largest)
+        largest = top - brk;
+
+    return largest;
+}
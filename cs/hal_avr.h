@@ -0,0 +1,143 @@
+/**
+ * @file hal_avr.h
+ * @brief Defines the ATmega backend of the hardware abstraction layer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The resources used are:
+ *
+ * - TIMER0 in CTC mode with a prescaler of 1024, for the scheduler.
+ * - TIMER1 in CTC mode with a prescaler of 1, toggling OC1A (PD5) to
+ *   generate the DCC signal.
+ * - TIMER2 in normal mode with a prescaler of 8, for the timing counter.
+ * - USART0, 8 data bits, with the receive complete interrupt.
+ * - PB6 and PB7 for the LEDs.
+ *
+ * Everything used in an interrupt handler is a macro or inline function,
+ * so the handlers compile exactly as if they used the registers directly.
+ * Include hal.h rather than this file.
+ */
+
+#ifndef HAL_AVR_DEFINED
+#define HAL_AVR_DEFINED
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+#define HAL_IRQ_DISABLE()           cli()
+#define HAL_IRQ_ENABLE()            sei()
+#define HAL_ATOMIC_BLOCK            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+
+#define HAL_ISR(vect)               ISR(vect)
+#define HAL_VECT_SCHEDULER          TIMER0_COMPA_vect
+#define HAL_VECT_SIGNAL             TIMER1_COMPA_vect
+#define HAL_VECT_USART_RX           USART0_RX_vect
+
+#define HAL_PGM_READ_PTR(p)         ((PGM_P) pgm_read_word(p))
+
+#define HAL_IDLE()
+
+/*
+ * Scheduler timer.
+ */
+#define HAL_SCHEDULER_PRESCALE      1024
+#define HAL_SCHEDULER_COUNT()       TCNT0
+#define HAL_SCHEDULER_PENDING()     (TIFR0 & (1 << OCF0A))
+
+static inline void
+Hal_scheduler_timer_init(uint8_t top)
+{
+    /* Set 8 bit timer to CTC mode. */
+    TCCR0A |= (1 << WGM01);
+
+    /* Set prescaler to 1024. */
+    TCCR0B |= ((1 << CS02) | (1 << CS00));
+
+    /* Enable the output compare a interupt. */
+    TIMSK0 |= (1 << OCIE0A);
+
+    /* Set the compare value for the timer. */
+    OCR0A = top;
+}
+
+/*
+ * Signal timer.
+ */
+#define HAL_SIGNAL_OUT              (1 << PD5)
+#define HAL_SIGNAL_SET_PERIOD(c)    (OCR1A = (c))
+#define HAL_SIGNAL_IS_HIGH()        (PIND & HAL_SIGNAL_OUT)
+
+static inline void
+Hal_signal_timer_init(void)
+{
+    /* Set the comparator as output. */
+    DDRD |= HAL_SIGNAL_OUT;
+
+    /* Set prescaler to 1 and 16 bit timer to CTC mode. */
+    TCCR1B |= ((1 << CS10) | (1 << WGM12));
+
+    /* Enable OC1A to be toggled when timer reached. */
+    TCCR1A |= (1 << COM1A0);
+}
+
+static inline void
+Hal_signal_timer_start(void)
+{
+    /* Enable the Output Compare A interrupt. */
+    TIMSK1 |= (1 << OCIE1A);
+}
+
+/*
+ * Timing counter.
+ */
+#define HAL_TIMING_PRESCALE         8
+#define HAL_TIMING_START()          do { TCNT2 = 0; TIFR2 = (1 << TOV2); } while(0)
+#define HAL_TIMING_COUNT()          TCNT2
+#define HAL_TIMING_OVERFLOW()       (TIFR2 & (1 << TOV2))
+
+static inline void
+Hal_timing_timer_init(void)
+{
+    /* Normal mode, prescaler of 8. */
+    TCCR2A = 0;
+    TCCR2B = (1 << CS21);
+}
+
+/*
+ * USART.
+ */
+#define HAL_USART_PRESCALE(baud)    ((F_CPU + (baud) * 8L) / ((baud) * 16UL) - 1)
+#define HAL_USART_RX_STATUS()       UCSR0A
+#define HAL_USART_RX_DATA()         UDR0
+#define HAL_USART_RX_FAILED(status) ((status) & ((1 << FE0) | (1 << DOR0)))
+#define HAL_USART_PUTC(c)           do { loop_until_bit_is_set(UCSR0A, UDRE0); \
+                                         UDR0 = (c); } while(0)
+
+static inline void
+Hal_usart_init(uint32_t baud)
+{
+    /* Set up USART with the receive complete interrupt. */
+    UCSR0B |= ((1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0));
+
+    /* Set up 8 bit transfer. */
+    UCSR0C |= ((1 << UCSZ01) | (1 << UCSZ00));
+
+    /* Set the baud prescale value. */
+    UBRR0H = (HAL_USART_PRESCALE(baud) >> 8);
+    UBRR0L = HAL_USART_PRESCALE(baud);
+}
+
+/*
+ * LEDs.
+ */
+#define HAL_LED1                    (1 << PB6)
+#define HAL_LED2                    (1 << PB7)
+#define HAL_LED_ON(led)             do { DDRB = 0xFF; PORTB |= (led); } while(0)
+#define HAL_LED_OFF(led)            do { DDRB = 0xFF; PORTB &= ~(led); } while(0)
+
+#define HAL_DELAY_MS(ms)            _delay_ms(ms)
+
+#endif
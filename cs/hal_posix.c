@@ -0,0 +1,829 @@
+/**
+ * @file hal_posix.c
+ * @brief Implements the POSIX host backend of the hardware abstraction layer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "hal.h"
+
+#define HAL_NS_PER_SEC          1000000000ULL
+#define HAL_CYCLES_PER_MS       (F_CPU / 1000)
+#define HAL_USART_FRAME_BITS    10      /**< Start bit, 8 data bits and a stop bit. */
+#define HAL_RX_BUF_LEN          256
+#define HAL_TX_BUF_LEN          256
+#define HAL_FMT_LEN             256
+#define HAL_LINGER_MS           1000    /**< Default run time after the input ends. */
+#define HAL_NEVER               UINT64_MAX
+#define HAL_VCD_BUF_LEN         65536
+
+/*
+ * Simulated events, in order of priority for events due on the same cycle
+ * (the order of the interrupt vectors on the target).
+ */
+#define HAL_EVENT_NONE          0
+#define HAL_EVENT_SIGNAL        1
+#define HAL_EVENT_SCHEDULER     2
+#define HAL_EVENT_USART_RX      3
+
+volatile uint8_t Hal_irq_enabled;
+uint8_t Hal_usart_rx_status;
+uint8_t Hal_usart_rx_data;
+uint8_t Hal_leds;
+
+static struct
+{
+    double speed;           /**< Simulated seconds per host second, 0 to run free. */
+    uint64_t limit;         /**< Cycles to run for, 0 to run until the input ends. */
+    uint64_t linger;        /**< Cycles to run once the input has ended. */
+    uint8_t pty;            /**< Serve on a pseudo terminal rather than stdio. */
+    const char *link;       /**< A symbolic link to create to the pseudo terminal. */
+    const char *vcd;        /**< A file to write the track signal to. */
+    const char *prog;
+} Hal_opts;
+
+/**
+ * The simulated clock, in cpu cycles since reset.
+ */
+static uint64_t Hal_cycles;
+static struct timespec Hal_host_start;
+
+static struct
+{
+    uint8_t running;
+    uint32_t period;        /**< Cycles between compare matches. */
+    uint64_t last;          /**< Cycle of the last compare match. */
+} Hal_scheduler;
+
+static struct
+{
+    uint8_t running;
+    uint8_t enabled;        /**< Whether the interrupt is enabled. */
+    uint8_t out;            /**< The output pin. */
+    uint16_t top;           /**< The compare value. */
+    uint64_t last;          /**< Cycle of the last compare match. */
+    uint64_t next;          /**< Cycle of the next compare match. */
+} Hal_signal;
+
+static struct
+{
+    uint8_t enabled;
+    uint8_t eof;
+    uint32_t frame;         /**< Cycles per character. */
+    uint64_t rx_next;       /**< Earliest cycle the next character can arrive. */
+    uint64_t tx_free;       /**< Cycle the transmitter is next free. */
+    uint64_t eof_at;        /**< Cycle the last character was received. */
+    int rx_fd;
+    int tx_fd;
+    unsigned char buf[HAL_RX_BUF_LEN];
+    int pos;
+    int len;
+    char tx_buf[HAL_TX_BUF_LEN];
+    int tx_len;
+} Hal_usart;
+
+static struct
+{
+    struct timespec start;
+    uint8_t sampled;
+    uint32_t ticks;
+} Hal_timing;
+
+/**
+ * The track signal capture.
+ */
+static struct
+{
+    FILE *file;
+    uint64_t time;          /**< The last time written, in nanoseconds. */
+    uint16_t top;           /**< The last compare value written. */
+} Hal_vcd;
+
+static FILE *Hal_stream;
+static int (*Hal_stream_put)(char, FILE *);
+static volatile sig_atomic_t Hal_stopped;
+
+static void Hal_usage(void);
+static void Hal_open_pty(void);
+static void Hal_unlink(void);
+static void Hal_stop(int sig);
+static void Hal_vcd_open(void);
+static void Hal_vcd_time(uint64_t cycles);
+static void Hal_vcd_top(uint16_t top);
+static void Hal_vcd_vector(uint16_t value, char id);
+static void Hal_flush(void);
+static void Hal_exit(void);
+static uint64_t Hal_host_ns(const struct timespec *since);
+static uint64_t Hal_host_cycles(void);
+static void Hal_read_input(void);
+static void Hal_wait(void);
+static void Hal_busy_wait(uint64_t until);
+static int Hal_next_event(uint64_t *at);
+static int Hal_step(uint64_t limit);
+static ssize_t Hal_stream_write(void *cookie, const char *buf, size_t size);
+
+/**
+ * Options:
+ *
+ * - -s speed, simulated seconds per host second (default 1), or 0 to run
+ *   as fast as the host allows.
+ * - -t ms, stop after the given simulated time.
+ * - -l ms, keep running for the given simulated time once the input has
+ *   ended (default 1000), so queued commands reach the track.
+ * - -p, serve on a pseudo terminal rather than stdin and stdout, printing
+ *   its path. This is the default for freedcc-emu. The terminal is held
+ *   open in raw mode, so clients may come and go, and output is dropped
+ *   while no client reads it, as on a real serial line.
+ * - -L path, with -p, also create a symbolic link to the terminal.
+ * - -w file, write the track signal to a value change dump, recording
+ *   every toggle of the output (dcc), every reload of its compare value in
+ *   cpu cycles (ocr1a) and every character received (rx), so commands can
+ *   be matched to the packets they give, with nanosecond timestamps.
+ */
+extern void
+Hal_init(int argc, char **argv)
+{
+    int opt;
+
+    Hal_opts.speed = 1;
+    Hal_opts.limit = 0;
+    Hal_opts.linger = (uint64_t) HAL_LINGER_MS * HAL_CYCLES_PER_MS;
+    Hal_opts.prog = argv[0];
+#ifdef HAL_POSIX_EMU
+    Hal_opts.pty = 1;
+#endif
+
+    while((opt = getopt(argc, argv, "s:t:l:pL:w:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 's':
+                Hal_opts.speed = atof(optarg);
+                break;
+
+            case 't':
+                Hal_opts.limit = strtoull(optarg, NULL, 10) * HAL_CYCLES_PER_MS;
+                break;
+
+            case 'l':
+                Hal_opts.linger = strtoull(optarg, NULL, 10) * HAL_CYCLES_PER_MS;
+                break;
+
+            case 'p':
+                Hal_opts.pty = 1;
+                break;
+
+            case 'L':
+                Hal_opts.link = optarg;
+                break;
+
+            case 'w':
+                Hal_opts.vcd = optarg;
+                break;
+
+            default:
+                Hal_usage();
+                exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    if(Hal_opts.speed < 0 || (Hal_opts.link != NULL && !Hal_opts.pty))
+    {
+        Hal_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    Hal_usart.rx_fd = STDIN_FILENO;
+    Hal_usart.tx_fd = STDOUT_FILENO;
+    Hal_usart.eof_at = HAL_NEVER;
+
+    if(Hal_opts.pty)
+        Hal_open_pty();
+
+    if(Hal_opts.vcd != NULL)
+        Hal_vcd_open();
+
+    /* Stop cleanly, so the captures are complete. */
+    signal(SIGINT, Hal_stop);
+    signal(SIGTERM, Hal_stop);
+    signal(SIGHUP, Hal_stop);
+
+    clock_gettime(CLOCK_MONOTONIC, &Hal_host_start);
+}
+
+extern FILE *
+Hal_stream_open(int (*put)(char, FILE *))
+{
+    cookie_io_functions_t io = { NULL, Hal_stream_write, NULL, NULL };
+
+    Hal_stream_put = put;
+    Hal_stream = fopencookie(NULL, "w", io);
+    setvbuf(Hal_stream, NULL, _IONBF, 0);
+
+    return Hal_stream;
+}
+
+extern void
+Hal_heap_note(void)
+{
+}
+
+extern void
+Hal_mem_report(struct Hal_mem *mem)
+{
+    memset(mem, 0, sizeof(*mem));
+}
+
+extern int
+Hal_printf_P(const char *fmt, ...)
+{
+    char buf[HAL_FMT_LEN];
+    const char *p;
+    va_list ap;
+    size_t i = 0;
+    int n;
+
+    /* Rewrite the flash string conversion %S as %s. */
+    for(p = fmt; *p != '\0' && i < (sizeof(buf) - 2); p++)
+    {
+        buf[i++] = *p;
+        if(*p != '%')
+            continue;
+
+        while(p[1] != '\0' && strchr("-+ #0123456789.hlz", p[1])
+            && i < (sizeof(buf) - 2))
+        {
+            buf[i++] = *++p;
+        }
+
+        if(p[1] == 'S' || p[1] == '%')
+        {
+            buf[i++] = (*++p == 'S' ? 's' : '%');
+        }
+    }
+    buf[i] = '\0';
+
+    va_start(ap, fmt);
+    n = vprintf((*p == '\0' ? buf : fmt), ap);
+    va_end(ap);
+
+    return n;
+}
+
+extern void
+Hal_poll(void)
+{
+    uint64_t target;
+    int event;
+
+    Hal_flush();
+    Hal_read_input();
+
+    if(Hal_usart.eof && Hal_usart.pos == Hal_usart.len && Hal_usart.eof_at == HAL_NEVER)
+        Hal_usart.eof_at = Hal_cycles;
+
+    if(Hal_stopped || (Hal_opts.limit > 0 && Hal_cycles >= Hal_opts.limit)
+        || (Hal_usart.eof_at != HAL_NEVER
+            && Hal_cycles >= Hal_usart.eof_at + Hal_opts.linger))
+    {
+        Hal_exit();
+    }
+
+    /* Run up to the host clock, stopping short of the end of the run. */
+    target = Hal_host_cycles();
+    if(Hal_opts.limit > 0 && target > Hal_opts.limit)
+        target = Hal_opts.limit;
+
+    if(Hal_usart.eof_at != HAL_NEVER && target > Hal_usart.eof_at + Hal_opts.linger)
+        target = Hal_usart.eof_at + Hal_opts.linger;
+
+    while((event = Hal_step(target)) != HAL_EVENT_NONE)
+    {
+        /* Let the main loop see received characters and queue space. */
+        if(event != HAL_EVENT_SIGNAL)
+            return;
+    }
+
+    /* Nothing more is due before the target. */
+    if(target != HAL_NEVER && target > Hal_cycles)
+        Hal_cycles = target;
+
+    if(Hal_opts.speed > 0)
+        Hal_wait();
+}
+
+extern void
+Hal_scheduler_timer_init(uint8_t top)
+{
+    Hal_scheduler.period = ((uint32_t) top + 1) * HAL_SCHEDULER_PRESCALE;
+    Hal_scheduler.last = Hal_cycles;
+    Hal_scheduler.running = 1;
+}
+
+extern uint8_t
+Hal_scheduler_count(void)
+{
+    if(!Hal_scheduler.running)
+        return 0;
+
+    return ((Hal_cycles - Hal_scheduler.last) % Hal_scheduler.period)
+        / HAL_SCHEDULER_PRESCALE;
+}
+
+extern uint8_t
+Hal_scheduler_pending(void)
+{
+    return (Hal_scheduler.running
+        && Hal_cycles >= Hal_scheduler.last + Hal_scheduler.period);
+}
+
+extern void
+Hal_signal_timer_init(void)
+{
+    Hal_signal.out = 0;
+    Hal_signal.last = Hal_cycles;
+    Hal_signal.next = HAL_NEVER;
+    Hal_signal.running = 1;
+}
+
+extern void
+Hal_signal_timer_start(void)
+{
+    Hal_signal.enabled = 1;
+}
+
+extern void
+Hal_signal_set_period(uint16_t cycles)
+{
+    uint64_t count = Hal_cycles - Hal_signal.last;
+
+    Hal_signal.top = cycles;
+
+    if(Hal_vcd.file != NULL && cycles != Hal_vcd.top)
+        Hal_vcd_top(cycles);
+
+    /* A compare value below the count is only reached after a wrap. */
+    Hal_signal.next = Hal_signal.last + cycles + 1 + (cycles < count ? 0x10000 : 0);
+}
+
+extern uint8_t
+Hal_signal_is_high(void)
+{
+    return Hal_signal.out;
+}
+
+extern void
+Hal_timing_timer_init(void)
+{
+    Hal_timing.sampled = 0;
+}
+
+extern void
+Hal_timing_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &Hal_timing.start);
+    Hal_timing.sampled = 0;
+}
+
+extern uint8_t
+Hal_timing_count(void)
+{
+    if(!Hal_timing.sampled)
+    {
+        /* One sample serves both the count and the overflow flag. */
+        Hal_timing.ticks = (Hal_host_ns(&Hal_timing.start) * F_CPU / HAL_NS_PER_SEC)
+            / HAL_TIMING_PRESCALE;
+        Hal_timing.sampled = 1;
+    }
+
+    /* Saturate rather than wrap a second time. */
+    return (Hal_timing.ticks > 511 ? 255 : Hal_timing.ticks & 0xFF);
+}
+
+extern uint8_t
+Hal_timing_overflow(void)
+{
+    Hal_timing_count();
+
+    return (Hal_timing.ticks > 255);
+}
+
+extern void
+Hal_usart_init(uint32_t baud)
+{
+    Hal_usart.frame = (HAL_USART_FRAME_BITS * F_CPU) / baud;
+    Hal_usart.rx_next = Hal_cycles;
+    Hal_usart.tx_free = Hal_cycles;
+    Hal_usart.enabled = 1;
+}
+
+extern void
+Hal_usart_putc(char c)
+{
+    /* Wait for the previous character to go, interrupts still run. */
+    Hal_busy_wait(Hal_usart.tx_free);
+
+    if(Hal_usart.tx_len == sizeof(Hal_usart.tx_buf))
+        Hal_flush();
+
+    Hal_usart.tx_buf[Hal_usart.tx_len++] = c;
+    Hal_usart.tx_free = Hal_cycles + Hal_usart.frame;
+}
+
+extern void
+Hal_delay_ms(unsigned ms)
+{
+    Hal_busy_wait(Hal_cycles + (uint64_t) ms * HAL_CYCLES_PER_MS);
+}
+
+static void
+Hal_usage(void)
+{
+    fprintf(stderr, "usage: %s [-s speed] [-t ms] [-l ms] [-p [-L path]] [-w file]\n", Hal_opts.prog);
+    fprintf(stderr, "  -s speed  simulated seconds per second, 0 to run free (default 1)\n");
+    fprintf(stderr, "  -t ms     stop after the given simulated time\n");
+    fprintf(stderr, "  -l ms     run time after the input ends (default %d)\n", HAL_LINGER_MS);
+    fprintf(stderr, "  -p        serve on a pseudo terminal\n");
+    fprintf(stderr, "  -L path   link path to the pseudo terminal\n");
+    fprintf(stderr, "  -w file   write the track signal to a value change dump\n");
+}
+
+/**
+ * Connect the USART to a new pseudo terminal.
+ */
+static void
+Hal_open_pty(void)
+{
+    struct termios tio;
+    const char *name;
+    int master, slave;
+
+    if((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) < 0
+        || unlockpt(master) < 0 || (name = ptsname(master)) == NULL)
+    {
+        perror("pseudo terminal");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Hold the terminal open, so it outlives each client, in raw mode. */
+    if((slave = open(name, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(slave, &tio) < 0)
+    {
+        perror(name);
+        exit(EXIT_FAILURE);
+    }
+
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B9600);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    /* Never stall the firmware on a client which is not reading. */
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    Hal_usart.rx_fd = master;
+    Hal_usart.tx_fd = master;
+
+    if(Hal_opts.link != NULL)
+    {
+        unlink(Hal_opts.link);
+        if(symlink(name, Hal_opts.link) < 0)
+        {
+            perror(Hal_opts.link);
+            exit(EXIT_FAILURE);
+        }
+
+        atexit(Hal_unlink);
+    }
+
+    fprintf(stderr, "%s: command station on %s\n", Hal_opts.prog,
+        (Hal_opts.link != NULL ? Hal_opts.link : name));
+}
+
+static void
+Hal_unlink(void)
+{
+    unlink(Hal_opts.link);
+}
+
+static void
+Hal_stop(int sig)
+{
+    Hal_stopped = 1;
+}
+
+static void
+Hal_vcd_open(void)
+{
+    if((Hal_vcd.file = fopen(Hal_opts.vcd, "w")) == NULL)
+    {
+        perror(Hal_opts.vcd);
+        exit(EXIT_FAILURE);
+    }
+
+    setvbuf(Hal_vcd.file, NULL, _IOFBF, HAL_VCD_BUF_LEN);
+
+    fprintf(Hal_vcd.file, "$version freedcc %s $end\n", Hal_opts.prog);
+    fprintf(Hal_vcd.file, "$timescale 1 ns $end\n");
+    fprintf(Hal_vcd.file, "$scope module cs $end\n");
+    fprintf(Hal_vcd.file, "$var wire 1 ! dcc $end\n");
+    fprintf(Hal_vcd.file, "$var reg 16 \" ocr1a $end\n");
+    fprintf(Hal_vcd.file, "$var reg 8 # rx $end\n");
+    fprintf(Hal_vcd.file, "$upscope $end\n");
+    fprintf(Hal_vcd.file, "$enddefinitions $end\n");
+    fprintf(Hal_vcd.file, "#0\n$dumpvars\n0!\nb0 \"\nb0 #\n$end\n");
+
+    Hal_vcd.time = 0;
+    Hal_vcd.top = 0;
+}
+
+/**
+ * Start a change at the given cycle, times never go backwards.
+ */
+static void
+Hal_vcd_time(uint64_t cycles)
+{
+    uint64_t ns = (cycles / F_CPU) * HAL_NS_PER_SEC
+        + ((cycles % F_CPU) * HAL_NS_PER_SEC) / F_CPU;
+
+    if(ns > Hal_vcd.time)
+    {
+        fprintf(Hal_vcd.file, "#%llu\n", (unsigned long long) ns);
+        Hal_vcd.time = ns;
+    }
+}
+
+/**
+ * Record a compare value reload.
+ */
+static void
+Hal_vcd_top(uint16_t top)
+{
+    Hal_vcd_time(Hal_cycles);
+    Hal_vcd_vector(top, '"');
+
+    Hal_vcd.top = top;
+}
+
+/**
+ * Record a vector value at the current time, in binary without leading
+ * zeros.
+ */
+static void
+Hal_vcd_vector(uint16_t value, char id)
+{
+    uint16_t bit;
+
+    for(bit = 0x8000; bit > 1 && !(value & bit); bit >>= 1)
+        ;
+
+    fputc('b', Hal_vcd.file);
+    for(; bit > 0; bit >>= 1)
+        fputc((value & bit ? '1' : '0'), Hal_vcd.file);
+    fprintf(Hal_vcd.file, " %c\n", id);
+}
+
+/**
+ * Write out the characters sent by the USART.
+ */
+static void
+Hal_flush(void)
+{
+    ssize_t n;
+    int done = 0;
+
+    while(done < Hal_usart.tx_len)
+    {
+        if((n = write(Hal_usart.tx_fd, Hal_usart.tx_buf + done, Hal_usart.tx_len - done)) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            /* Nobody is listening, the characters are lost. */
+            break;
+        }
+
+        done += n;
+    }
+
+    Hal_usart.tx_len = 0;
+}
+
+static void
+Hal_exit(void)
+{
+    Hal_flush();
+    exit(EXIT_SUCCESS);
+}
+
+static uint64_t
+Hal_host_ns(const struct timespec *since)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) (now.tv_sec - since->tv_sec) * HAL_NS_PER_SEC
+        + now.tv_nsec - since->tv_nsec;
+}
+
+/**
+ * The simulated cycle the host clock has reached.
+ */
+static uint64_t
+Hal_host_cycles(void)
+{
+    if(Hal_opts.speed == 0)
+        return HAL_NEVER;
+
+    return (uint64_t) ((double) Hal_host_ns(&Hal_host_start) * Hal_opts.speed
+        * F_CPU / HAL_NS_PER_SEC);
+}
+
+/**
+ * Read what input is available without blocking.
+ */
+static void
+Hal_read_input(void)
+{
+    struct timeval zero = { 0, 0 };
+    fd_set fds;
+    ssize_t n;
+
+    if(Hal_usart.eof || Hal_usart.pos < Hal_usart.len)
+        return;
+
+    FD_ZERO(&fds);
+    FD_SET(Hal_usart.rx_fd, &fds);
+    if(select(Hal_usart.rx_fd + 1, &fds, NULL, NULL, &zero) <= 0)
+        return;
+
+    if((n = read(Hal_usart.rx_fd, Hal_usart.buf, sizeof(Hal_usart.buf))) <= 0)
+    {
+        if(n < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+
+        Hal_usart.eof = 1;
+        return;
+    }
+
+    Hal_usart.pos = 0;
+    Hal_usart.len = n;
+
+    /* The first character is still on the wire. */
+    if(Hal_usart.rx_next < Hal_cycles + Hal_usart.frame)
+        Hal_usart.rx_next = Hal_cycles + Hal_usart.frame;
+}
+
+/**
+ * Sleep until the next event is due on the host clock, or input arrives.
+ */
+static void
+Hal_wait(void)
+{
+    struct timeval timeout;
+    uint64_t at, ns;
+    fd_set fds;
+
+    if(Hal_next_event(&at) == HAL_EVENT_NONE || at <= Hal_cycles)
+        return;
+
+    ns = (uint64_t) ((double) (at - Hal_cycles) * HAL_NS_PER_SEC
+        / (F_CPU * Hal_opts.speed));
+    timeout.tv_sec = ns / HAL_NS_PER_SEC;
+    timeout.tv_usec = (ns % HAL_NS_PER_SEC) / 1000;
+
+    FD_ZERO(&fds);
+    if(!Hal_usart.eof && Hal_usart.pos == Hal_usart.len)
+        FD_SET(Hal_usart.rx_fd, &fds);
+
+    select(Hal_usart.rx_fd + 1, &fds, NULL, NULL, &timeout);
+}
+
+/**
+ * Advance the clock as a busy loop on the target would, running the
+ * interrupt handlers which fall due.
+ */
+static void
+Hal_busy_wait(uint64_t until)
+{
+    while(Hal_cycles < until)
+    {
+        if(Hal_step(until) == HAL_EVENT_NONE)
+            Hal_cycles = until;
+    }
+}
+
+/**
+ * Find the next event and the cycle it is due.
+ */
+static int
+Hal_next_event(uint64_t *at)
+{
+    int event = HAL_EVENT_NONE;
+
+    *at = HAL_NEVER;
+
+    if(Hal_signal.running && Hal_signal.next < *at)
+    {
+        *at = Hal_signal.next;
+        event = HAL_EVENT_SIGNAL;
+    }
+
+    if(Hal_scheduler.running && Hal_scheduler.last + Hal_scheduler.period < *at)
+    {
+        *at = Hal_scheduler.last + Hal_scheduler.period;
+        event = HAL_EVENT_SCHEDULER;
+    }
+
+    if(Hal_usart.enabled && Hal_usart.pos < Hal_usart.len && Hal_usart.rx_next < *at)
+    {
+        *at = Hal_usart.rx_next;
+        event = HAL_EVENT_USART_RX;
+    }
+
+    return event;
+}
+
+/**
+ * Run the next event, if it is due by the given cycle and interrupts are
+ * enabled.
+ */
+static int
+Hal_step(uint64_t limit)
+{
+    uint64_t at;
+    int event;
+
+    if(!Hal_irq_enabled || (event = Hal_next_event(&at)) == HAL_EVENT_NONE || at > limit)
+        return HAL_EVENT_NONE;
+
+    /* Interrupts held off by the main loop are taken late. */
+    if(at > Hal_cycles)
+        Hal_cycles = at;
+
+    Hal_irq_enabled = 0;
+
+    switch(event)
+    {
+        case HAL_EVENT_SIGNAL:
+            /* The output toggles and the counter restarts on the match. */
+            Hal_signal.out ^= 1;
+            Hal_signal.last = at;
+            if(Hal_vcd.file != NULL)
+            {
+                Hal_vcd_time(at);
+                fprintf(Hal_vcd.file, "%d!\n", Hal_signal.out);
+            }
+
+            Hal_signal.next = at + Hal_signal.top + 1;
+            if(Hal_signal.enabled)
+                HAL_VECT_SIGNAL();
+            break;
+
+        case HAL_EVENT_SCHEDULER:
+            Hal_scheduler.last = at + ((Hal_cycles - at) / Hal_scheduler.period)
+                * Hal_scheduler.period;
+            HAL_VECT_SCHEDULER();
+            break;
+
+        case HAL_EVENT_USART_RX:
+            Hal_usart_rx_status = 0;
+            Hal_usart_rx_data = Hal_usart.buf[Hal_usart.pos++];
+            if(Hal_vcd.file != NULL)
+            {
+                Hal_vcd_time(at);
+                Hal_vcd_vector(Hal_usart_rx_data, '#');
+            }
+            Hal_usart.rx_next = at + Hal_usart.frame;
+            HAL_VECT_USART_RX();
+            break;
+    }
+
+    Hal_irq_enabled = 1;
+
+    return event;
+}
+
+static ssize_t
+Hal_stream_write(void *cookie, const char *buf, size_t size)
+{
+    size_t i;
+
+    for(i=0; i < size; i++)
+        Hal_stream_put(buf[i], Hal_stream);
+
+    return size;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file hal_posix.h
+ * @brief Defines the POSIX host backend of the hardware abstraction layer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This backend runs the firmware as an ordinary process, so the whole
+ * command station can be built, profiled and benchmarked on a host.
+ *
+ * The microcontroller is simulated against a cpu cycle clock running at
+ * F_CPU. The scheduler and signal timers and the USART receiver raise
+ * their interrupts at the cycle they would on the target, in the order the
+ * target would, and the handlers run from HAL_IDLE() in the main loop.
+ * The main loop itself takes no simulated time, except when writing to
+ * the USART, which like the target waits for each character to be sent.
+ *
+ * The USART is connected to stdin and stdout, or to a pseudo terminal
+ * which clients open as they would the serial port of the target (this is
+ * freedcc-emu, built with HAL_POSIX_EMU). Received characters are paced
+ * at the configured baud rate. The simulated clock follows the host
+ * clock, scaled by a speed factor, or runs as fast as the host allows.
+ * See Hal_init() for the options.
+ *
+ * Flash is ordinary memory, and the flash string functions map onto their
+ * standard library counterparts. The %S conversion for flash strings is
+ * accepted by printf_P().
+ *
+ * The timing counter measures host time, converted to cpu cycles at
+ * F_CPU. Memory usage is not measured.
+ *
+ * Include hal.h rather than this file.
+ */
+
+#ifndef HAL_POSIX_DEFINED
+#define HAL_POSIX_DEFINED
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The interrupt enable flag.
+ */
+extern volatile uint8_t Hal_irq_enabled;
+
+#define HAL_IRQ_DISABLE()           (Hal_irq_enabled = 0)
+#define HAL_IRQ_ENABLE()            (Hal_irq_enabled = 1)
+#define HAL_ATOMIC_BLOCK            for(uint8_t hal_irq_save_ = Hal_irq_enabled, \
+                                        hal_irq_once_ = (Hal_irq_enabled = 0, 1); \
+                                        hal_irq_once_; \
+                                        Hal_irq_enabled = hal_irq_save_, hal_irq_once_ = 0)
+
+#define HAL_ISR(vect)               void vect(void)
+#define HAL_VECT_SCHEDULER          Hal_isr_scheduler
+#define HAL_VECT_SIGNAL             Hal_isr_signal
+#define HAL_VECT_USART_RX           Hal_isr_usart_rx
+
+extern void HAL_VECT_SCHEDULER(void);
+extern void HAL_VECT_SIGNAL(void);
+extern void HAL_VECT_USART_RX(void);
+
+/*
+ * Flash strings.
+ */
+#define PROGMEM
+#define PGM_P                       const char *
+#define PSTR(s)                     (s)
+#define pgm_read_byte(p)            (*(const uint8_t *) (p))
+#define pgm_read_word(p)            (*(const uint16_t *) (p))
+#define strncmp_P                   strncmp
+#define printf_P                    Hal_printf_P
+
+#define HAL_PGM_READ_PTR(p)         (*(p))
+
+extern int Hal_printf_P(const char *fmt, ...);
+
+#define HAL_IDLE()                  Hal_poll()
+
+/**
+ * Advance the simulation, running the interrupt handlers which fall due.
+ * Returns after a scheduler or receive interrupt, so the main loop can
+ * act on it, or when the simulation has caught up with the host clock.
+ */
+extern void Hal_poll(void);
+
+/*
+ * Scheduler timer.
+ */
+#define HAL_SCHEDULER_PRESCALE      1024
+#define HAL_SCHEDULER_COUNT()       Hal_scheduler_count()
+#define HAL_SCHEDULER_PENDING()     Hal_scheduler_pending()
+
+extern void Hal_scheduler_timer_init(uint8_t top);
+extern uint8_t Hal_scheduler_count(void);
+extern uint8_t Hal_scheduler_pending(void);
+
+/*
+ * Signal timer.
+ */
+#define HAL_SIGNAL_SET_PERIOD(c)    Hal_signal_set_period(c)
+#define HAL_SIGNAL_IS_HIGH()        Hal_signal_is_high()
+
+extern void Hal_signal_timer_init(void);
+extern void Hal_signal_timer_start(void);
+extern void Hal_signal_set_period(uint16_t cycles);
+extern uint8_t Hal_signal_is_high(void);
+
+/*
+ * Timing counter.
+ */
+#define HAL_TIMING_PRESCALE         8
+#define HAL_TIMING_START()          Hal_timing_start()
+#define HAL_TIMING_COUNT()          Hal_timing_count()
+#define HAL_TIMING_OVERFLOW()       Hal_timing_overflow()
+
+extern void Hal_timing_timer_init(void);
+extern void Hal_timing_start(void);
+extern uint8_t Hal_timing_count(void);
+extern uint8_t Hal_timing_overflow(void);
+
+/*
+ * USART.
+ */
+#define HAL_USART_RX_STATUS()       Hal_usart_rx_status
+#define HAL_USART_RX_DATA()         Hal_usart_rx_data
+#define HAL_USART_RX_FAILED(status) (status)
+#define HAL_USART_PUTC(c)           Hal_usart_putc(c)
+
+extern uint8_t Hal_usart_rx_status;
+extern uint8_t Hal_usart_rx_data;
+
+extern void Hal_usart_init(uint32_t baud);
+extern void Hal_usart_putc(char c);
+
+/*
+ * LEDs.
+ */
+#define HAL_LED1                    (1 << 6)
+#define HAL_LED2                    (1 << 7)
+#define HAL_LED_ON(led)             (Hal_leds |= (led))
+#define HAL_LED_OFF(led)            (Hal_leds &= ~(led))
+
+extern uint8_t Hal_leds;
+
+#define HAL_DELAY_MS(ms)            Hal_delay_ms(ms)
+
+extern void Hal_delay_ms(unsigned ms);
+
+#endif
@@ -1,14 +0,0 @@
-/**
- * @file init.h
- * @brief Defines the application wide constants.
- * @author Mikey Austin
- * @date 2010-2011
- */
-
-#ifndef INIT_DEFINED
-#define INIT_DEFINED
-
-#define F_CPU 14745600UL
-#define INIT_ATMEGA644P
-
-#endif
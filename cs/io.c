@@ -7,192 +7,517 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
+#include <ctype.h>
 
+#include "hal.h"
 #include "io.h"
 #include "dsl.h"
 #include "ring.h"
+#include "scheduler.h"
+#include "trace.h"
 #include "utils.h"
-#include "init.h"
+#include "config.h"
 
-#define IO_RINGSIZE              50
-#define IO_BAUD_RATE             9600
-#define IO_BAUD_PRESCALE         ((F_CPU + IO_BAUD_RATE * 8L) / (IO_BAUD_RATE * 16UL) - 1)
+#define IO_RINGSIZE              CONFIG_RX_BUFFER_LEN
+#define IO_BAUD_RATE             CONFIG_BAUD_RATE
 #define IO_PROMPT                "freedcc> "
+#define IO_RX_ERROR              -1     /**< Marks lost or corrupt input in the receive ring. */
+#define IO_CRC_POLY              0x07
 
+/*
+ * Replies to a command.
+ */
+#define IO_REPLY_OK              0
+#define IO_REPLY_ERR             1
+#define IO_REPLY_FULL            2
+#define IO_REPLY_NAK             3
+
+/*
+ * Outcome of framing a received character.
+ */
+#define IO_FRAME_DATA            0      /**< Part of the command, feed to the parser. */
+#define IO_FRAME_SKIP            1      /**< Consumed by the framing. */
+#define IO_FRAME_END             2      /**< End of a good line. */
+#define IO_FRAME_BAD             3      /**< End of a corrupt line. */
+
+/**
+ * Receive ring, filled by the USART receive interrupt and drained into
+ * the DSL parser by the main loop. Lost or corrupt characters are
+ * replaced by IO_RX_ERROR so that only the affected line is discarded.
+ */
 static volatile Ring_T IO_rx_ring;
-static FILE IO_stream;
+static FILE *IO_stream;
+
+/**
+ * Set by the receive interrupt when a character is dropped because the
+ * receive ring is full.
+ */
+static volatile uint8_t IO_rx_overflow;
+
+/**
+ * The previous character received, used to collapse CR/LF pairs.
+ */
+static int IO_last_rx;
+
+/**
+ * The current interaction mode.
+ */
+static int IO_mode;
+
+/**
+ * Framing state of the line being received.
+ */
+static struct
+{
+    /* Whether lines must end with a CRC. */
+    uint8_t crc_mode;
+
+    /* The CRC of the line so far. */
+    uint8_t crc;
+
+    /* The CRC sent by the host, and the number of hex digits seen. */
+    uint8_t crc_rx;
+    int8_t crc_digits;
+
+    /* The line is known to be bad. */
+    uint8_t bad;
+
+    /* The line lost input to a receive error, already counted. */
+    uint8_t lost;
+
+    /* The line has content. */
+    uint8_t data;
+} IO_frame;
+
+/**
+ * Machine mode replies, indexed by reply code.
+ */
+static const char IO_reply_ok[] PROGMEM = "ok";
+static const char IO_reply_err[] PROGMEM = "err";
+static const char IO_reply_full[] PROGMEM = "full";
+static const char IO_reply_nak[] PROGMEM = "nak";
+static PGM_P const IO_replies[] PROGMEM = {
+    IO_reply_ok, IO_reply_err, IO_reply_full, IO_reply_nak
+};
+
+/**
+ * Human mode replies, indexed by reply code.
+ */
+static const char IO_msg_ok[] PROGMEM = "ok\n\n";
+static const char IO_msg_err[] PROGMEM = "parse error\n\n";
+static const char IO_msg_full[] PROGMEM = "queue full, try again\n\n";
+static const char IO_msg_nak[] PROGMEM = "line corrupt, try again\n\n";
+static PGM_P const IO_messages[] PROGMEM = {
+    IO_msg_ok, IO_msg_err, IO_msg_full, IO_msg_nak
+};
 
 static int IO_putc(char c, FILE *stream);
-static int IO_getc(FILE *stream);
-static void IO_flush(void);
-static void IO_free_address(void *args);
+static int IO_frame_char(int c);
+static void IO_frame_reset(void);
+static uint8_t IO_crc8_update(uint8_t crc, uint8_t data);
+static void IO_reply(uint8_t reply, int seq);
+static void IO_sent(void);
+static void IO_prompt(void);
 
 extern void
 IO_module_init(void)
 {
-    /* Set up USART. */
-    UCSR0B |= ((1 << RXEN0) | (1 << TXEN0));
-
-    /* Set up 8 bit transfer. */
-    UCSR0C |= ((1 << UCSZ01) | (1 << UCSZ00));
-
-    /* Set the baud prescale value. */
-    UBRR0H = (IO_BAUD_PRESCALE >> 8);
-    UBRR0L = IO_BAUD_PRESCALE;
+    /* Set up the USART with the receive complete interrupt. */
+    Hal_usart_init(IO_BAUD_RATE);
 
     /* Set up module buffer. */
     IO_rx_ring = Ring_create(RING_TYPE_INT, IO_RINGSIZE);
+    IO_rx_overflow = 0;
+    IO_last_rx = 0;
+    IO_mode = IO_MODE_HUMAN;
+    IO_frame.crc_mode = 0;
+    IO_frame_reset();
 
-    /* Setup IO stream. */
-    fdev_setup_stream(&IO_stream, IO_putc, IO_getc, _FDEV_SETUP_RW);
+    /* Setup IO stream, input is pushed to the parser rather than read. */
+    IO_stream = Hal_stream_open(IO_putc);
 
     /* Initialise the DSL scanner & parser. */
-    DSL_module_init(IO_flush);
+    DSL_module_init();
+    Sys_heap_mark();
 
-    /* Set stdio default streams for convenience. */
-    stdout = &IO_stream;
-    stdin = &IO_stream;
+    /* Set stdio default stream for convenience. */
+    stdout = IO_stream;
 }
 
 extern DCC_packet_T
 IO_read(void)
 {
-    int c;
-    DSL_result_T result = NULL;
-    DCC_packet_T packet = NULL;
+    int c, status, seq;
+    union Ring_data popped;
+    struct DSL_result_T result;
 
-    if(UCSR0A & (1 << RXC0))
+    /* Report packets which have reached the track. */
+    IO_sent();
+
+    /* Feed received characters to the parser until a line completes. */
+    while(IO_rx_ring->count > 0)
     {
-        if((c = getchar()) != '\n' && c != ' ')
+        HAL_IRQ_DISABLE();
+        popped = Ring_pop(IO_rx_ring);
+        HAL_IRQ_ENABLE();
+
+        if((c = popped.i) == '\n' && IO_last_rx == '\r')
+        {
+            /* Second half of a CR/LF pair. */
+            IO_last_rx = c;
+            continue;
+        }
+
+        IO_last_rx = c;
+
+        if(IO_mode == IO_MODE_HUMAN && c != IO_RX_ERROR)
+        {
+            /* Echo. */
+            IO_putc((c == '\r' ? '\n' : c), IO_stream);
+        }
+
+        switch(IO_frame_char(c))
+        {
+            case IO_FRAME_SKIP:
+                continue;
+
+            case IO_FRAME_BAD:
+                /* Drop the line, reporting the tag if it survived. */
+                seq = DSL_parser_seq();
+                DSL_parser_reset();
+                Sys_heap_mark();
+                Sys_link_increment(SYS_LINK_FRAME);
+                Sys_link_increment(SYS_LINK_BAD_FRAME);
+                IO_reply((IO_frame.crc_mode ? IO_REPLY_NAK : IO_REPLY_ERR), seq);
+                IO_frame_reset();
+                IO_prompt();
+                continue;
+
+            case IO_FRAME_END:
+                c = '\n';
+                break;
+
+            default:
+                /* Normalise whitespace for the parser. */
+                if(c == '\t')
+                    c = ' ';
+                break;
+        }
+
+        if((status = DSL_parser_feed(c, &result)) == DSL_PARSE_PENDING)
         {
-            ungetc(c, stdin);
+            continue;
+        }
 
-            if(DSL_parser_start(&result))
+        if(status != DSL_PARSE_EMPTY)
+            Sys_link_increment(SYS_LINK_FRAME);
+
+        IO_frame_reset();
+
+        if(status == DSL_PARSE_OK)
+        {
+            /* A valid packet has been received. */
+            if(result.type != DSL_RES_TYPE_SYS)
             {
-                /* A valid packet has been received. */
+                /* Start the command to rails latency measurement. */
+                result.payload.packet->stamp = Scheduler_now();
+            }
+
+            if(IO_mode == IO_MODE_HUMAN)
+            {
+                /* The blink delay would throttle a host streaming commands. */
                 blink_led(LED2, 1);
-                Sys_parse_ok_increment();
-
-                switch(result->type)
-                {
-                    case DSL_RES_TYPE_RAW:
-                    case DSL_RES_TYPE_DCC:
-                        printf_P(PSTR("ok\n\n"));
-                        packet = result->payload.packet;
-                        Sys_process_dcc_tx(packet);
-                        break;
-
-                    case DSL_RES_TYPE_SYS:
-                        Sys_process_sys_cmd(result->payload.cmd);
-                        result->payload.cmd->call(result->payload.cmd->args);
-                        Sys_cmd_destroy(result->payload.cmd, IO_free_address);
-                        break;
-                }
-
-                free(result);
             }
-            else
+
+            Sys_parse_ok_increment();
+
+            switch(result.type)
             {
-                Sys_parse_err_increment();
-                printf_P(PSTR("parse error\n\n"));
+                case DSL_RES_TYPE_RAW:
+                case DSL_RES_TYPE_DCC:
+                case DSL_RES_TYPE_DATA:
+                    /* Acknowledged once the scheduler has it. */
+                    Sys_heap_account();
+                    return result.payload.packet;
+
+                case DSL_RES_TYPE_SYS:
+                    Sys_process_sys_cmd(&result.payload.cmd);
+                    result.payload.cmd.call(result.payload.cmd.arg);
+
+                    /* System commands answer for themselves in human mode. */
+                    if(IO_mode == IO_MODE_MACHINE)
+                        IO_reply(IO_REPLY_OK, result.seq);
+                    break;
             }
         }
+        else if(status == DSL_PARSE_ERROR)
+        {
+            Sys_parse_err_increment();
+            IO_reply(IO_REPLY_ERR, result.seq);
+        }
 
-        /* Print prompt. */
-        printf_P(PSTR("\r%s"), IO_PROMPT);
+        Sys_heap_account();
+        IO_prompt();
+    }
+
+    return NULL;
+}
+
+extern void
+IO_queued(DCC_packet_T packet, int queued)
+{
+    if(queued)
+    {
+        Sys_process_dcc_tx(packet);
+        IO_reply(IO_REPLY_OK, packet->seq);
+    }
+    else
+    {
+        IO_reply(IO_REPLY_FULL, packet->seq);
+        DCC_packet_destroy(packet);
+    }
+
+    IO_prompt();
+}
+
+extern void
+IO_set_mode(int mode)
+{
+    IO_mode = mode;
+}
+
+extern int
+IO_get_mode(void)
+{
+    return IO_mode;
+}
+
+extern int
+IO_report_current_size(void)
+{
+    return IO_rx_ring->count;
+}
+
+extern int
+IO_report_total_size(void)
+{
+    return IO_RINGSIZE;
+}
+
+extern void
+IO_set_crc(int enable)
+{
+    IO_frame.crc_mode = enable;
+}
+
+HAL_ISR(HAL_VECT_USART_RX)
+{
+    uint8_t status;
+    union Ring_data rx, lost;
+
+    /* The status must be read before the data register. */
+    status = HAL_USART_RX_STATUS();
+    rx.i = HAL_USART_RX_DATA();
+    lost.i = IO_RX_ERROR;
+
+    if(IO_rx_overflow && IO_rx_ring->count < IO_rx_ring->size)
+    {
+        /* Mark where input was lost to a full ring. */
+        Ring_push(IO_rx_ring, lost);
+        IO_rx_overflow = 0;
     }
 
-    return packet;
+    if(HAL_USART_RX_FAILED(status))
+    {
+        /* A framing error, or characters lost in the USART. */
+        Sys_link_increment(SYS_LINK_RX_ERROR);
+        rx = lost;
+    }
+
+    if(IO_rx_ring->count == IO_rx_ring->size)
+    {
+        if(!IO_rx_overflow)
+            Sys_link_increment(SYS_LINK_RX_ERROR);
+
+        IO_rx_overflow = 1;
+        return;
+    }
+
+    Ring_push(IO_rx_ring, rx);
 }
 
+/**
+ * Apply the line framing to a received character.
+ *
+ * Without CRC checking each command is a frame, ended by a newline or a
+ * semicolon, so input lost to a USART error voids only its own command.
+ *
+ * In CRC mode every line carries exactly one command and must end with an
+ * asterisk followed by two hex digits, giving the CRC-8 (polynomial 0x07,
+ * initial value 0) of all bytes of the line before the asterisk:
+ *
+ * @code
+ * #12 forward addr 3 speed 4*CD
+ * @endcode
+ */
 static int
-IO_getc(FILE *stream)
+IO_frame_char(int c)
 {
-    union Ring_data popped, rx;
+    int end = (c == '\n' || c == '\r');
+
+    if(c == IO_RX_ERROR)
+    {
+        IO_frame.bad = 1;
+        IO_frame.lost = 1;
+        return IO_FRAME_SKIP;
+    }
 
-    if(IO_rx_ring->count == 0)
+    if(!IO_frame.crc_mode)
     {
-        /* Poll UART until we get a line of input. */
-        for(;;)
+        /* The parser ends a command at a semicolon too. */
+        end = (end || c == ';');
+
+        if(end && IO_frame.bad)
+            return IO_FRAME_BAD;
+
+        IO_frame.data = (IO_frame.data || !end);
+
+        return (end ? IO_FRAME_END : IO_FRAME_DATA);
+    }
+
+    if(end)
+    {
+        if(!IO_frame.data)
         {
-            loop_until_bit_is_set(UCSR0A, RXC0);
+            /* Blank lines need no CRC. */
+            return IO_FRAME_END;
+        }
 
-            if(UCSR0A & (1 << FE0))
-            {
-                return _FDEV_EOF;
-            }
-            else if(UCSR0A & (1 << DOR0))
-            {
-                return _FDEV_ERR;
-            }
+        if(IO_frame.lost)
+        {
+            /* Not a CRC error, the lost input was counted as it happened. */
+            return IO_FRAME_BAD;
+        }
 
-            switch((rx.i = UDR0))
-            {
-                case '\t':
-                    rx.i = ' ';
-                    break;
+        if(IO_frame.bad || IO_frame.crc_digits != 2 || IO_frame.crc != IO_frame.crc_rx)
+        {
+            Sys_link_increment(SYS_LINK_CRC_ERROR);
+            return IO_FRAME_BAD;
+        }
 
-                case '\r':
-                    rx.i = '\n';
-                    break;
-            }
+        return IO_FRAME_END;
+    }
 
-            Ring_push(IO_rx_ring, rx);
-            IO_putc(rx.i, stream);
+    IO_frame.data = 1;
 
-            if(rx.i == '\n')
-            {
-                break;
-            }
+    if(IO_frame.crc_digits >= 0)
+    {
+        /* Reading the CRC. */
+        if(IO_frame.crc_digits < 2 && isxdigit(c))
+        {
+            IO_frame.crc_rx = (IO_frame.crc_rx << 4)
+                | (isdigit(c) ? (c - '0') : (tolower(c) - 'a' + 10));
+            IO_frame.crc_digits++;
         }
+        else
+        {
+            IO_frame.bad = 1;
+        }
+
+        return IO_FRAME_SKIP;
     }
 
-    popped = Ring_pop(IO_rx_ring);
+    if(c == '*')
+    {
+        IO_frame.crc_digits = 0;
+        return IO_FRAME_SKIP;
+    }
 
-    return popped.i;
+    if(c == ';')
+    {
+        /* A frame holds a single command. */
+        IO_frame.bad = 1;
+        return IO_FRAME_SKIP;
+    }
+
+    IO_frame.crc = IO_crc8_update(IO_frame.crc, c);
+
+    return IO_FRAME_DATA;
 }
 
-static int
-IO_putc(char c, FILE *stream)
+static void
+IO_frame_reset(void)
+{
+    IO_frame.crc = 0;
+    IO_frame.crc_rx = 0;
+    IO_frame.crc_digits = -1;
+    IO_frame.bad = 0;
+    IO_frame.lost = 0;
+    IO_frame.data = 0;
+}
+
+static uint8_t
+IO_crc8_update(uint8_t crc, uint8_t data)
+{
+    int i;
+
+    crc ^= data;
+
+    for(i=0; i < 8; i++)
+        crc = ((crc & 0x80) ? ((crc << 1) ^ IO_CRC_POLY) : (crc << 1));
+
+    return crc;
+}
+
+static void
+IO_reply(uint8_t reply, int seq)
 {
-    if(c == '\n')
+    if(IO_mode == IO_MODE_HUMAN)
     {
-        IO_putc('\r', stream);
+        printf_P(HAL_PGM_READ_PTR(&IO_messages[reply]));
+        return;
     }
 
-    /* Wait until we can write. */
-    loop_until_bit_is_set(UCSR0A, UDRE0);
+    printf_P(HAL_PGM_READ_PTR(&IO_replies[reply]));
 
-    /* Write the byte. */
-    UDR0 = c;
+    if(seq != DSL_SEQ_NONE)
+        printf_P(PSTR(" %d"), seq);
 
-    return 0;
+    putchar('\n');
 }
 
 static void
-IO_flush(void)
+IO_sent(void)
 {
-    unsigned char dummy __attribute__ ((unused));
-
-    /* Reset rx ring. */
-    Ring_reset(IO_rx_ring);
+    int seq;
 
-    /* Flush USART receive buffer. */
-    while(UCSR0A & (1 << RXC0))
+    while(Scheduler_next_sent(&seq))
     {
-        dummy = UDR0;
+        if(IO_mode == IO_MODE_MACHINE)
+            printf_P(PSTR("tx %d\n"), seq);
     }
 
-    /* Clear stream EOF and error flags. */
-    clearerror(&IO_stream);
+    if(IO_mode == IO_MODE_MACHINE)
+        Trace_stream();
 }
 
 static void
-IO_free_address(void *args)
+IO_prompt(void)
 {
-    if(args)
-        free(args);
+    if(IO_mode == IO_MODE_HUMAN)
+        printf_P(PSTR("\r%s"), IO_PROMPT);
+}
+
+static int
+IO_putc(char c, FILE *stream)
+{
+    if(c == '\n' && IO_mode == IO_MODE_HUMAN)
+    {
+        IO_putc('\r', stream);
+    }
+
+    /* Wait until we can write, then write the byte. */
+    HAL_USART_PUTC(c);
+
+    return 0;
 }
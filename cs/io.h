@@ -13,6 +13,9 @@
 
 #include "dcc.h"
 
+#define IO_MODE_HUMAN   0
+#define IO_MODE_MACHINE 1
+
 /** 
  * Initialise the IO module
  * 
@@ -23,11 +26,77 @@ extern void IO_module_init(void);
 /** 
  * Get a new packet from host.
  *
- * This function checks the IO module buffer to see if a new packet has
- * been received.
+ * This function feeds any characters received since the last call to the
+ * DSL parser, and never waits for more input. Complete lines are parsed
+ * and executed as they are seen.
+ *
+ * A returned packet has not been acknowledged yet, the caller must report
+ * the outcome of queueing it with IO_queued().
  *
  * @return Returns a DCC packet if one was received, NULL otherwise.
  */
 extern DCC_packet_T IO_read(void);
 
+/**
+ * Acknowledge a packet returned by IO_read().
+ *
+ * @param packet The packet returned by IO_read().
+ * @param queued Whether the scheduler accepted the packet. If not, the
+ *  packet is destroyed and the client is told to retry.
+ */
+extern void IO_queued(DCC_packet_T packet, int queued);
+
+/**
+ * Select the interaction mode.
+ *
+ * In human mode (the default) input is echoed, commands are answered with
+ * readable messages and a prompt is printed after each line.
+ *
+ * In machine mode there is no echo and no prompt. Each command is
+ * answered with a single line, followed by the client sequence number if
+ * the command was tagged, so a host program can keep several commands in
+ * flight and match up the replies:
+ *
+ * - "ok" the command was executed, or its packet accepted by the scheduler
+ * - "err" the command could not be parsed, or lost characters to a USART
+ *   error
+ * - "full" the scheduler queue is full, the command should be resent
+ *
+ * - "nak" the line was corrupted on the serial link, see IO_set_crc()
+ *
+ * Tagged packet commands later receive an asynchronous "tx" line when
+ * the packet is first transmitted to the track. With "trace on", each new
+ * packet sent is also reported with an asynchronous "trace" line (see
+ * trace.h).
+ *
+ * @param mode One of IO_MODE_HUMAN or IO_MODE_MACHINE.
+ */
+extern void IO_set_mode(int mode);
+
+/**
+ * Return the current interaction mode, IO_MODE_HUMAN or IO_MODE_MACHINE.
+ */
+extern int IO_get_mode(void);
+
+/** Return the number of received characters waiting to be read. */
+extern int IO_report_current_size(void);
+
+/** Return the capacity of the receive buffer. */
+extern int IO_report_total_size(void);
+
+/**
+ * Enable or disable CRC checking of received lines.
+ *
+ * With CRC checking enabled every line holds one command and must end with
+ * an asterisk and the two digit hex CRC-8 (polynomial 0x07, initial value 0)
+ * of the bytes before the asterisk. A line which fails the check, or which
+ * lost characters to a USART error, is not executed and is answered with
+ * "nak" and its sequence number, so the host only resends that line. The
+ * sequence number is taken from the damaged line itself, so a host should
+ * also time out commands which are never answered.
+ *
+ * @param enable Non-zero to require a CRC on every line.
+ */
+extern void IO_set_crc(int enable);
+
 #endif
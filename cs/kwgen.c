@@ -0,0 +1,207 @@
+/**
+ * @file kwgen.c
+ * @brief Build time generator for the DSL keyword recogniser.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This host program searches for a perfect hash over the DSL keywords,
+ * keyed on the keyword length and its first and last characters, and
+ * writes a header containing the flash resident keyword table and the
+ * lookup function used by the token scanner.
+ *
+ * The hash has the form:
+ *
+ * @code
+ * h = (uint8_t) (len * A + first * B + last * C) % N
+ * @endcode
+ *
+ * where N is the smallest table size not less than the number of
+ * keywords for which coefficients A, B and C exist. A lookup therefore
+ * costs one hash computation and a single flash string compare, no
+ * matter how large the vocabulary grows.
+ *
+ * To add a keyword, add it to the table below along with its token
+ * (defined in dsl.h) and rebuild.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KWGEN_MAX_COEFF 64
+#define KWGEN_MAX_SLOTS 256
+
+struct Kwgen_keyword
+{
+    const char *str;
+    const char *tok;
+};
+
+/**
+ * The DSL vocabulary, including abbreviations.
+ */
+static const struct Kwgen_keyword Kwgen_keywords[] = {
+    { "raw",        "DSL_TOK_RAW"     },
+    { "rawdata",    "DSL_TOK_RAWDATA" },
+    { "forward",    "DSL_TOK_FORWARD" },
+    { "fw",         "DSL_TOK_FORWARD" },
+    { "reverse",    "DSL_TOK_REVERSE" },
+    { "rv",         "DSL_TOK_REVERSE" },
+    { "stop",       "DSL_TOK_STOP"    },
+    { "addr",       "DSL_TOK_ADDR"    },
+    { "ad",         "DSL_TOK_ADDR"    },
+    { "speed",      "DSL_TOK_SPEED"   },
+    { "sp",         "DSL_TOK_SPEED"   },
+    { "all",        "DSL_TOK_ALL"     },
+    { "show",       "DSL_TOK_SHOW"    },
+    { "cache",      "DSL_TOK_CACHE"   },
+    { "clear",      "DSL_TOK_CLEAR"   },
+    { "status",     "DSL_TOK_STATUS"  },
+    { "timing",     "DSL_TOK_TIMING"  },
+    { "bandwidth",  "DSL_TOK_BANDWIDTH" },
+    { "latency",    "DSL_TOK_LATENCY" },
+    { "trace",      "DSL_TOK_TRACE"   },
+    { "locos",      "DSL_TOK_LOCOS"   },
+    { "help",       "DSL_TOK_HELP"    },
+    { "mode",       "DSL_TOK_MODE"    },
+    { "machine",    "DSL_TOK_MACHINE" },
+    { "human",      "DSL_TOK_HUMAN"   },
+    { "crc",        "DSL_TOK_CRC"     },
+    { "on",         "DSL_TOK_ON"      },
+    { "off",        "DSL_TOK_OFF"     }
+};
+
+#define KWGEN_NUM_KEYWORDS (sizeof(Kwgen_keywords) / sizeof(Kwgen_keywords[0]))
+
+static int Kwgen_hash(const char *str, int a, int b, int c, int n);
+static int Kwgen_search(int n, int *a, int *b, int *c);
+static void Kwgen_emit(int n, int a, int b, int c);
+
+int
+main(int argc, char **argv)
+{
+    int n, a, b, c;
+
+    for(n = KWGEN_NUM_KEYWORDS; n <= KWGEN_MAX_SLOTS; n++)
+    {
+        if(Kwgen_search(n, &a, &b, &c))
+        {
+            Kwgen_emit(n, a, b, c);
+            return EXIT_SUCCESS;
+        }
+    }
+
+    fprintf(stderr, "kwgen: no perfect hash found for %d keywords\n",
+        (int) KWGEN_NUM_KEYWORDS);
+
+    return EXIT_FAILURE;
+}
+
+static int
+Kwgen_hash(const char *str, int a, int b, int c, int n)
+{
+    int len = strlen(str);
+
+    /* Mirror the 8 bit arithmetic performed on the target. */
+    return ((unsigned char) (len * a + str[0] * b + str[len - 1] * c)) % n;
+}
+
+static int
+Kwgen_search(int n, int *a, int *b, int *c)
+{
+    unsigned char used[KWGEN_MAX_SLOTS];
+    int i, h;
+
+    for(*a = 0; *a < KWGEN_MAX_COEFF; (*a)++)
+    {
+        for(*b = 0; *b < KWGEN_MAX_COEFF; (*b)++)
+        {
+            for(*c = 0; *c < KWGEN_MAX_COEFF; (*c)++)
+            {
+                memset(used, 0, sizeof(used));
+
+                for(i=0; i < KWGEN_NUM_KEYWORDS; i++)
+                {
+                    h = Kwgen_hash(Kwgen_keywords[i].str, *a, *b, *c, n);
+                    if(used[h])
+                        break;
+
+                    used[h] = 1;
+                }
+
+                if(i == KWGEN_NUM_KEYWORDS)
+                {
+                    /* Every keyword hashed to a distinct slot. */
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void
+Kwgen_emit(int n, int a, int b, int c)
+{
+    const struct Kwgen_keyword *slots[KWGEN_MAX_SLOTS];
+    int i, h, max_len = 0;
+
+    memset(slots, 0, sizeof(slots));
+
+    for(i=0; i < KWGEN_NUM_KEYWORDS; i++)
+    {
+        h = Kwgen_hash(Kwgen_keywords[i].str, a, b, c, n);
+        slots[h] = &Kwgen_keywords[i];
+
+        if(strlen(Kwgen_keywords[i].str) > max_len)
+            max_len = strlen(Kwgen_keywords[i].str);
+    }
+
+    printf("/*\n * Generated by kwgen, do not edit.\n *\n");
+    printf(" * %d keywords in %d slots.\n */\n\n", (int) KWGEN_NUM_KEYWORDS, n);
+    printf("#ifndef DSL_KW_INCLUDED\n#define DSL_KW_INCLUDED\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("#define DSL_KW_MAX_LEN    %d\n", max_len);
+    printf("#define DSL_KW_TABLE_SIZE %d\n", n);
+    printf("#define DSL_KW_HASH(len, first, last) \\\n");
+    printf("    ((uint8_t) ((uint8_t) (len) * %d + (uint8_t) (first) * %d"
+           " + (uint8_t) (last) * %d) %% %d)\n\n", a, b, c, n);
+
+    printf("struct DSL_kw\n{\n");
+    printf("    char    s[DSL_KW_MAX_LEN + 1];\n");
+    printf("    uint8_t tok;\n};\n\n");
+
+    printf("static const struct DSL_kw DSL_kw_table[DSL_KW_TABLE_SIZE] PROGMEM = {\n");
+    for(i=0; i < n; i++)
+    {
+        if(slots[i])
+        {
+            printf("    { \"%s\", %s }", slots[i]->str, slots[i]->tok);
+        }
+        else
+        {
+            printf("    { \"\", 0 }");
+        }
+
+        printf("%s\n", (i < (n - 1) ? "," : ""));
+    }
+    printf("};\n\n");
+
+    printf("/**\n");
+    printf(" * Return the token for the lower case keyword of the given length,\n");
+    printf(" * or 0 if it is not a keyword.\n");
+    printf(" */\n");
+    printf("static uint8_t\nDSL_kw_lookup(const char *str, uint8_t len)\n{\n");
+    printf("    const struct DSL_kw *kw;\n\n");
+    printf("    if(len == 0 || len > DSL_KW_MAX_LEN)\n");
+    printf("        return 0;\n\n");
+    printf("    kw = &DSL_kw_table[DSL_KW_HASH(len, str[0], str[len - 1])];\n\n");
+    printf("    /* A single flash compare confirms the candidate. */\n");
+    printf("    if(strncmp_P(str, kw->s, len) != 0 || pgm_read_byte(&kw->s[len]) != '\\0')\n");
+    printf("        return 0;\n\n");
+    printf("    return pgm_read_byte(&kw->tok);\n");
+    printf("}\n\n");
+
+    printf("#endif\n");
+}
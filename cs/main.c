@@ -6,34 +6,43 @@
  */
 
 #include <stdlib.h>
-#include <avr/interrupt.h>
 
+#include "hal.h"
 #include "dcc.h"
 #include "scheduler.h"
 #include "io.h"
 #include "utils.h"
 #include "sys.h"
+#include "clock.h"
+#include "trace.h"
+#include "timing.h"
 
 int
 main(int argc, char **argv)
 {
     DCC_packet_T packet;
 
+    Hal_init(argc, argv);
+    Clock_module_init();
     Sys_init();
+    Timing_module_init();
+    Trace_module_init();
     Scheduler_module_init();
     IO_module_init();
 
     /* Enable interrupts. */
-    sei();
+    HAL_IRQ_ENABLE();
 
     /* Power on LED. */
     LED1_ON;
     
     for(;;)
     {
+        HAL_IDLE();
+
         if((packet = IO_read()) != NULL)
         {
-            Scheduler_add_packet(packet);
+            IO_queued(packet, Scheduler_add_packet(packet));
         }
     }
 
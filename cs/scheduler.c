@@ -6,17 +6,44 @@
  */
 
 #include <stdlib.h>
-#include <avr/interrupt.h>
-#include <avr/io.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
 
+#include "hal.h"
 #include "ring.h"
 #include "signal.h"
 #include "utils.h"
 #include "cache.h"
+#include "clock.h"
 #include "scheduler.h"
+#include "sys.h"
+#include "timing.h"
+#include "trace.h"
 
 #define SCHEDULER_FLUSH_PERIOD    124   /**< 8 milliseconds @ 14.7456MHz, prescaler of 1024. */
-#define SCHEDULER_TX_QUEUE_LEN    20
+#define SCHEDULER_TX_QUEUE_LEN    CONFIG_TX_QUEUE_LEN
+
+/*
+ * Track bandwidth accounting. Each packet sent is counted against its
+ * category, along with the number of one and zero bits it puts on the
+ * track. The counts are kept in slots of about a second each, and the
+ * completed slots form the rolling reporting window.
+ */
+#define SCHEDULER_SLOT_TICKS      115   /**< Flush periods per slot, 115 x 8.68ms ~ 1s. */
+#define SCHEDULER_SLOTS           5     /**< The current slot plus the window. */
+#define SCHEDULER_TICK_CYCLES     128000UL  /**< Cpu cycles per flush period. */
+#define SCHEDULER_BIT_1_CYCLES    1704UL    /**< Cpu cycles per one bit (2 x 852). */
+#define SCHEDULER_BIT_0_CYCLES    3234UL    /**< Cpu cycles per zero bit (2 x 1617). */
+#define SCHEDULER_SLOT_CYCLES     (SCHEDULER_SLOT_TICKS * SCHEDULER_TICK_CYCLES)
+
+struct Scheduler_usage
+{
+    uint16_t packets;
+    uint16_t ones;
+    uint16_t zeros;
+};
 
 /**
  * Queue to hold new packets that are to be sent.
@@ -35,6 +62,46 @@ static DCC_packet_T Scheduler_idle_packet;
  */
 static DCC_packet_T Scheduler_stop_packet;
 
+/**
+ * Sequence numbers of tagged packets which have reached the track,
+ * waiting to be acknowledged by the main loop.
+ */
+static Ring_T Scheduler_sent_queue;
+
+/**
+ * Track usage per slot and category, and the flush period within the
+ * current slot.
+ */
+static struct Scheduler_usage Scheduler_usage[SCHEDULER_SLOTS][SCHEDULER_NUM_CATS];
+static uint8_t Scheduler_slot;
+static uint8_t Scheduler_slot_ticks;
+
+/**
+ * Slots completed since boot, up to the window's worth, so the report
+ * covers only the time elapsed until the window has filled.
+ */
+static uint8_t Scheduler_slots_done;
+
+/**
+ * Flush periods elapsed, the high part of the scheduler clock.
+ */
+static volatile uint16_t Scheduler_ticks;
+
+static const char Scheduler_cat_new[] PROGMEM = "new";
+static const char Scheduler_cat_refresh[] PROGMEM = "refresh";
+static const char Scheduler_cat_stop[] PROGMEM = "stop";
+static const char Scheduler_cat_idle[] PROGMEM = "idle";
+
+static PGM_P const Scheduler_cat_names[SCHEDULER_NUM_CATS] PROGMEM = {
+    Scheduler_cat_new,
+    Scheduler_cat_refresh,
+    Scheduler_cat_stop,
+    Scheduler_cat_idle
+};
+
+static void Scheduler_account(int cat, DCC_packet_T packet);
+static void Scheduler_tick(void);
+
 extern void
 Scheduler_module_init(void)
 {
@@ -43,6 +110,7 @@ Scheduler_module_init(void)
 
     /* Set up the transmit queue for new packets. */
     Scheduler_tx_queue = Ring_create(RING_TYPE_PACKET, SCHEDULER_TX_QUEUE_LEN);
+    Scheduler_sent_queue = Ring_create(RING_TYPE_INT, SCHEDULER_TX_QUEUE_LEN);
 
     /* Set up an idle packet. */
     Scheduler_idle_packet = DCC_baseline_packet_create();
@@ -51,54 +119,261 @@ Scheduler_module_init(void)
     /* The parser will create this packet. */
     Scheduler_stop_packet = NULL;
 
-    /* Set 8 bit timer to CTC mode. */
-    TCCR0A |= (1 << WGM01);
-
-    /* Set prescaler to 1024. */
-    TCCR0B |= ((1 << CS02) | (1 << CS00));
-
-    /* Enable the output compare a interupt. */
-    TIMSK0 |= (1 << OCIE0A);
+    /* Start with an empty bandwidth window. */
+    memset(Scheduler_usage, 0, sizeof(Scheduler_usage));
+    Scheduler_slot = 0;
+    Scheduler_slot_ticks = 0;
+    Scheduler_slots_done = 0;
+    Scheduler_ticks = 0;
 
-    /* Set the compare value for the timer. */
-    OCR0A = SCHEDULER_FLUSH_PERIOD;
+    /* Interrupt every flush period. */
+    Hal_scheduler_timer_init(SCHEDULER_FLUSH_PERIOD);
 }
 
-extern void
+extern int
 Scheduler_add_packet(DCC_packet_T packet)
 {
     union Ring_data new;
+    int queued = 0;
 
     /* Prepare new ring data. */
     new.p = packet;
 
     /* Disable interrupts. */
-    cli();
+    HAL_IRQ_DISABLE();
 
-    /* Push the new packet onto the first ring. */
-    Ring_push(Scheduler_tx_queue, new);
+    /* Push the new packet onto the first ring if there is room. */
+    if(Scheduler_tx_queue->count < Scheduler_tx_queue->size)
+    {
+        Ring_push(Scheduler_tx_queue, new);
+        queued = 1;
+    }
 
     /* Re-enable interrupts. */
-    sei();
+    HAL_IRQ_ENABLE();
+
+    return queued;
+}
+
+extern int
+Scheduler_next_sent(int *seq)
+{
+    union Ring_data sent;
+
+    if(Scheduler_sent_queue->count == 0)
+        return 0;
+
+    HAL_IRQ_DISABLE();
+    sent = Ring_pop(Scheduler_sent_queue);
+    HAL_IRQ_ENABLE();
+
+    *seq = sent.i;
+
+    return 1;
+}
+
+extern int
+Scheduler_report_current_size(void)
+{
+    return Scheduler_tx_queue->count;
+}
+
+extern int
+Scheduler_report_total_size(void)
+{
+    return SCHEDULER_TX_QUEUE_LEN;
+}
+
+extern uint16_t
+Scheduler_now(void)
+{
+    uint16_t ticks;
+    uint8_t count;
+
+    HAL_ATOMIC_BLOCK
+    {
+        ticks = Scheduler_ticks;
+        count = HAL_SCHEDULER_COUNT();
+
+        /* The counter may have been reset before the handler could run. */
+        if(HAL_SCHEDULER_PENDING())
+        {
+            ticks++;
+            count = HAL_SCHEDULER_COUNT();
+        }
+    }
+
+    return (ticks * (SCHEDULER_FLUSH_PERIOD + 1)) + count;
+}
+
+extern PGM_P
+Scheduler_cat_name(int cat)
+{
+    return HAL_PGM_READ_PTR(&Scheduler_cat_names[cat]);
+}
+
+extern void
+Scheduler_report_bandwidth(int machine)
+{
+    struct Scheduler_usage total[SCHEDULER_NUM_CATS];
+    uint32_t cycles, rate, window, window_ms, busy = 0, idle = 0;
+    uint8_t current;
+    int i, j;
+
+    memset(total, 0, sizeof(total));
+
+    /* Sum the completed slots, the interrupt handler fills the current one. */
+    HAL_IRQ_DISABLE();
+    current = Scheduler_slot;
+    window = Scheduler_slots_done * SCHEDULER_SLOT_CYCLES;
+    for(i=0; i < SCHEDULER_SLOTS; i++)
+    {
+        if(i == current)
+            continue;
+
+        for(j=0; j < SCHEDULER_NUM_CATS; j++)
+        {
+            total[j].packets += Scheduler_usage[i][j].packets;
+            total[j].ones += Scheduler_usage[i][j].ones;
+            total[j].zeros += Scheduler_usage[i][j].zeros;
+        }
+    }
+    HAL_IRQ_ENABLE();
+
+    window_ms = window / (F_CPU / 1000);
+
+    if(machine)
+        printf_P(PSTR("bandwidth window_ms=%" PRIu32), window_ms);
+    else
+        printf_P(PSTR("bandwidth details (last %" PRIu32 " ms)\n"), window_ms);
+
+    for(j=0; j < SCHEDULER_NUM_CATS; j++)
+    {
+        PGM_P name = Scheduler_cat_name(j);
+
+        cycles = total[j].ones * SCHEDULER_BIT_1_CYCLES
+            + total[j].zeros * SCHEDULER_BIT_0_CYCLES;
+
+        if(j == SCHEDULER_CAT_IDLE)
+            idle += cycles;
+        else
+            busy += cycles;
+
+        /* Rates to one decimal place, in tenths. */
+        rate = (window_ms == 0 ? 0 : total[j].packets * 10000UL / window_ms);
+
+        if(machine)
+        {
+            printf_P(PSTR(" %S_packets_per_sec=%" PRIu32 ".%" PRIu32 " %S_percent="), name,
+                     rate / 10, rate % 10, name);
+            print_percent_value(cycles, window);
+            continue;
+        }
+
+        printf_P(PSTR("  %S_packets_per_sec:\t%" PRIu32 ".%" PRIu32 "\n"), name,
+                 rate / 10, rate % 10);
+        printf_P(PSTR("  %S_percent:\t\t"), name);
+        print_percent(cycles, window);
+        printf_P(PSTR("\n"));
+    }
+
+    /* Between packets the signal module fills the track with ones. */
+    if(window > busy + idle)
+        idle = window - busy;
+
+    if(machine)
+    {
+        /* The idle category already has idle_percent. */
+        printf_P(PSTR(" utilisation_percent="));
+        print_percent_value(busy, window);
+        printf_P(PSTR(" track_idle_percent="));
+        print_percent_value(idle, window);
+        printf_P(PSTR("\n"));
+        return;
+    }
+
+    printf_P(PSTR("  utilisation_percent:\t"));
+    print_percent(busy, window);
+    printf_P(PSTR("\n  idle_percent:\t\t"));
+    print_percent(idle, window);
+    printf_P(PSTR("\n\n"));
+}
+
+static void
+Scheduler_account(int cat, DCC_packet_T packet)
+{
+    struct Scheduler_usage *usage = &Scheduler_usage[Scheduler_slot][cat];
+    uint8_t byte, ones = 0;
+    int i;
+
+    for(i=0; i < packet->size; i++)
+    {
+        /* Clear the lowest set bit until none remain. */
+        for(byte = packet->bytes[i]; byte; byte &= (byte - 1))
+            ones++;
+    }
+
+    usage->packets++;
+    usage->ones += ones;
+    usage->zeros += (packet->size * 8) - ones;
 
-    return;
+    TRACE_RECORD(cat, packet);
 }
 
-ISR(TIMER0_COMPA_vect)
+static void
+Scheduler_tick(void)
 {
-    union Ring_data tx;
+    if(++Scheduler_slot_ticks < SCHEDULER_SLOT_TICKS)
+        return;
+
+    /* Start a new slot, dropping the oldest from the window. */
+    Scheduler_slot_ticks = 0;
+    if(++Scheduler_slot == SCHEDULER_SLOTS)
+        Scheduler_slot = 0;
+
+    memset(Scheduler_usage[Scheduler_slot], 0, sizeof(Scheduler_usage[Scheduler_slot]));
+
+    if(Scheduler_slots_done < (SCHEDULER_SLOTS - 1))
+        Scheduler_slots_done++;
+}
+
+HAL_ISR(HAL_VECT_SCHEDULER)
+{
+    union Ring_data tx, sent;
     DCC_packet_T cached;
 
+    TIMING_ENTER();
+
+    Scheduler_ticks++;
+    Clock_tick();
+
     /* Initialise packets. */
     tx.p = cached = NULL;
 
-    if(Scheduler_tx_queue->count > 0)
+    if(Signal_busy())
+    {
+        /*
+         * The last packet is still on the track, a long packet of
+         * mostly zero bits can take more than one flush period.
+         */
+    }
+    else if(Scheduler_tx_queue->count > 0)
     {
         /*
          * There is a new packet to send.
          */
         tx = Ring_pop(Scheduler_tx_queue);
         Signal_send(tx.p->bytes, tx.p->size);
+        Scheduler_account(SCHEDULER_CAT_NEW, tx.p);
+        Sys_latency_record(Scheduler_now() - tx.p->stamp);
+
+        if(tx.p->seq != DCC_SEQ_NONE
+            && Scheduler_sent_queue->count < Scheduler_sent_queue->size)
+        {
+            /* Let the client know this command has reached the rails. */
+            sent.i = tx.p->seq;
+            Ring_push(Scheduler_sent_queue, sent);
+        }
 
         if(Scheduler_stop_packet != NULL)
         {
@@ -129,13 +404,23 @@ ISR(TIMER0_COMPA_vect)
         if(Scheduler_stop_packet != NULL)
         {
             cached = Scheduler_stop_packet;
+            Scheduler_account(SCHEDULER_CAT_STOP, cached);
         }
         else if((cached = Cache_get_next_packet()) == NULL)
         {
             cached = Scheduler_idle_packet;
+            Scheduler_account(SCHEDULER_CAT_IDLE, cached);
+        }
+        else
+        {
+            Scheduler_account(SCHEDULER_CAT_REFRESH, cached);
         }
 
         /* Destroying of packets is handled by the cache. */
         Signal_send(cached->bytes, cached->size);
     }
+
+    Scheduler_tick();
+
+    TIMING_EXIT(TIMING_ISR_SCHEDULER);
 }
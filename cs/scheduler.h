@@ -13,8 +13,23 @@
 #ifndef DEFINED_SCHEDULER
 #define DEFINED_SCHEDULER
 
+#include <stdint.h>
+
+#include "hal.h"
+
 #include "dcc.h"
 
+#define SCHEDULER_CLOCK_HZ  14400   /**< Scheduler clock rate, F_CPU / 1024. */
+
+/*
+ * The source of each packet sent to the track.
+ */
+#define SCHEDULER_CAT_NEW       0   /**< New packets from the transmit queue. */
+#define SCHEDULER_CAT_REFRESH   1   /**< Packets refreshed from the cache. */
+#define SCHEDULER_CAT_STOP      2   /**< Re-sent broadcast stop packets. */
+#define SCHEDULER_CAT_IDLE      3   /**< Idle packets. */
+#define SCHEDULER_NUM_CATS      4
+
 /**
  * Set up the Scheduler module.
  *
@@ -29,7 +44,55 @@ extern void Scheduler_module_init(void);
  * This function firstly checks for packets with the same address in the
  * queues to determine if there is room, then adds the packet to the
  * appropriate queue based on the packet priority.
+ *
+ * @return 1 if the packet was queued, 0 if the queue is full in which
+ *  case the caller keeps ownership of the packet.
+ */
+extern int Scheduler_add_packet(DCC_packet_T packet);
+
+/**
+ * Fetch the sequence number of a tagged packet which has started
+ * transmission to the track since the last call.
+ *
+ * @param seq Set to the sequence number of the sent packet.
+ *
+ * @return 1 if a sequence number was fetched, 0 if there are none.
+ */
+extern int Scheduler_next_sent(int *seq);
+
+/** Return the number of packets waiting in the transmit queue. */
+extern int Scheduler_report_current_size(void);
+
+/** Return the capacity of the transmit queue. */
+extern int Scheduler_report_total_size(void);
+
+/**
+ * Read the scheduler clock.
+ *
+ * The clock counts TIMER0 increments (69.4 microseconds each) and wraps
+ * about every 4.5 seconds, so it is only suitable for timing short
+ * intervals, as the unsigned difference of two readings.
+ *
+ * @return The current clock value.
+ */
+extern uint16_t Scheduler_now(void);
+
+/**
+ * Fetch the name of a packet source.
+ *
+ * @param cat One of the SCHEDULER_CAT_* sources.
+ *
+ * @return The name, in program memory.
+ */
+extern PGM_P Scheduler_cat_name(int cat);
+
+/**
+ * Print the track bandwidth used by new, refreshed, broadcast stop and idle
+ * packets over the last few seconds, or the time since boot until then,
+ * as packets per second and as a percentage of track time.
+ *
+ * @param machine Non-zero to print a single line of key=value pairs.
  */
-extern void Scheduler_add_packet(DCC_packet_T packet);
+extern void Scheduler_report_bandwidth(int machine);
 
 #endif
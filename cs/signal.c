@@ -7,11 +7,11 @@
 
 #include <stdlib.h>
 #include <assert.h>
-#include <avr/interrupt.h> 
-#include <avr/io.h>
 
+#include "hal.h"
 #include "signal.h"
 #include "utils.h"
+#include "timing.h"
 
 #define SIGNAL_HALF_PERIOD_1        852     /**< 58 microseconds @ 14.7456MHz, prescaler of 1. */
 #define SIGNAL_HALF_PERIOD_0        1617    /**< 110 microseconds @ 14.7456MHz, prescaler of 1. */
@@ -41,20 +41,14 @@ Signal_module_init()
     for(i=0; i < SIGNAL_MAX_BYTES; i++)
         Signal_state.bytes[i] = 0x00;
 
-    /* Set the comparator as output. */
-    DDRD |= SIGNAL_OUT;
-
-    /* Set prescaler to 1 and 16 bit timer to CTC mode. */
-    TCCR1B |= ((1 << CS10) | (1 << WGM12));
-
-    /* Enable OC1A to be toggled when timer reached. */
-    TCCR1A |= (1 << COM1A0);
+    /* Toggle the signal output in CTC mode. */
+    Hal_signal_timer_init();
 
     /* Start the signal. */
     Signal_generate_bit(1);
 
-    /* Enable the Output Compare A interrupt. */
-    TIMSK1 |= (1 << OCIE1A);
+    /* Enable the compare interrupt. */
+    Hal_signal_timer_start();
 }
 
 extern void
@@ -78,18 +72,29 @@ Signal_send(unsigned char *bytes, int size)
         & (1 << Signal_state.cur_bit--));
 }
 
+extern int
+Signal_busy(void)
+{
+    return (Signal_state.cur_byte < Signal_state.size);
+}
+
 static void 
 Signal_generate_bit(unsigned char bit)
 {
     /* If it's not zero, then it must be a one. */
-    OCR1A = (bit == 0 ? SIGNAL_HALF_PERIOD_0 : SIGNAL_HALF_PERIOD_1);
+    HAL_SIGNAL_SET_PERIOD(bit == 0 ? SIGNAL_HALF_PERIOD_0 : SIGNAL_HALF_PERIOD_1);
 }
 
-ISR(TIMER1_COMPA_vect)
+HAL_ISR(HAL_VECT_SIGNAL)
 {
+    TIMING_ENTER();
+
     /* Generate second half of bit signal with same compare value. */
-    if(!(PIND & SIGNAL_OUT))
+    if(!HAL_SIGNAL_IS_HIGH())
+    {
+        TIMING_EXIT(TIMING_ISR_SIGNAL);
         return;
+    }
 
     if(Signal_state.cur_byte < Signal_state.size
         && Signal_state.cur_bit > 0)
@@ -118,4 +123,6 @@ ISR(TIMER1_COMPA_vect)
     {
         Signal_generate_bit(1);
     }
+
+    TIMING_EXIT(TIMING_ISR_SIGNAL);
 }
@@ -12,8 +12,9 @@
 #ifndef SIGNAL_DEFINED
 #define SIGNAL_DEFINED
 
-#define SIGNAL_OUT          (1 << PD5)
-#define SIGNAL_MAX_BYTES    15
+#include "config.h"
+
+#define SIGNAL_MAX_BYTES    CONFIG_MAX_PACKET_SIZE
 
 /** Initialise the signal module. */
 extern void Signal_module_init(void);
@@ -29,4 +30,14 @@ extern void Signal_module_init(void);
  */
 extern void Signal_send(unsigned char *bytes, int size);
 
+/**
+ * Report whether a packet is still being modulated.
+ *
+ * A packet of mostly zero bits may take longer than a flush period, so a
+ * caller must not send another until this returns zero.
+ *
+ * @return Non-zero while bytes remain to be sent.
+ */
+extern int Signal_busy(void);
+
 #endif
@@ -7,25 +7,98 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
+#include <string.h>
+#include <inttypes.h>
 
+#include "hal.h"
 #include "cache.h"
+#include "clock.h"
+#include "io.h"
+#include "scheduler.h"
 #include "sys.h"
+#include "timing.h"
+#include "trace.h"
+#include "utils.h"
 
 #define T               Sys_cmd_T
-#define SYS_TOT_MEM     4096
 
-static int Sys_tx_count;
-static int Sys_tx_bytes_count;
-static int Sys_parse_err_count;
-static int Sys_parse_ok_count;
-static int Sys_sys_cmd_count;
+/*
+ * Convert scheduler clock counts to microseconds. The ratio is reduced so
+ * that a full 16 bit count cannot overflow.
+ */
+#define SYS_CLOCKS_US(c) ((uint32_t) (c) * 625 / 9)
+
+_Static_assert(SCHEDULER_CLOCK_HZ * 625UL == 1000000UL * 9,
+               "SYS_CLOCKS_US does not match SCHEDULER_CLOCK_HZ");
+
+/*
+ * Convert milliseconds to scheduler clock counts, rounding up so that a
+ * count reaches the bound exactly when its whole milliseconds do.
+ */
+#define SYS_MS_CLOCKS(ms) ((uint16_t) (((uint32_t) (ms) * SCHEDULER_CLOCK_HZ + 999) / 1000))
+
+#define SYS_LATENCY_BUCKETS 10
 
-static void Sys_cmd_status(void *args);
-static void Sys_cmd_help(void *args);
-static void Sys_cmd_cache_clear(void *args);
-static void Sys_cmd_cache_show(void *args);
+static uint32_t Sys_tx_count;
+static uint32_t Sys_tx_bytes_count;
+static uint32_t Sys_parse_err_count;
+static uint32_t Sys_parse_ok_count;
+static uint32_t Sys_sys_cmd_count;
+static uint32_t Sys_link_frame_count;
+static uint32_t Sys_link_bad_frame_count;
+static uint32_t Sys_link_crc_error_count;
+static uint32_t Sys_link_rx_error_count;
+static uint32_t Sys_heap_alloc_count;
+static uint32_t Sys_heap_free_count;
+static uint32_t Sys_heap_mark_count;
+static int Sys_heap_cmd_allocs;
+static int Sys_heap_cmd_allocs_max;
+
+/**
+ * Command to rails latency, in scheduler clock counts.
+ */
+struct Sys_latency
+{
+    uint16_t min;
+    uint16_t max;
+    uint32_t total;
+    uint32_t count;
+    uint16_t hist[SYS_LATENCY_BUCKETS];
+};
+
+static struct Sys_latency Sys_latency;
+
+/**
+ * Upper bounds of the latency histogram buckets, the last bucket holds
+ * the rest. Kept in scheduler clock counts so the interrupt handler need
+ * not convert, and printed in milliseconds.
+ */
+static const uint16_t Sys_latency_bounds[SYS_LATENCY_BUCKETS - 1] PROGMEM = {
+    SYS_MS_CLOCKS(1), SYS_MS_CLOCKS(2), SYS_MS_CLOCKS(5), SYS_MS_CLOCKS(10),
+    SYS_MS_CLOCKS(20), SYS_MS_CLOCKS(50), SYS_MS_CLOCKS(100), SYS_MS_CLOCKS(200),
+    SYS_MS_CLOCKS(500)
+};
+
+static void Sys_cmd_status(int arg);
+static void Sys_cmd_help(int arg);
+static void Sys_cmd_cache_clear(int arg);
+static void Sys_cmd_cache_show(int arg);
+static void Sys_cmd_mode(int arg);
+static void Sys_cmd_crc(int arg);
+static void Sys_cmd_timing(int arg);
+static void Sys_cmd_bandwidth(int arg);
+static void Sys_cmd_latency(int arg);
+static void Sys_cmd_trace_show(int arg);
+static void Sys_cmd_trace(int arg);
+static void Sys_cmd_locos(int arg);
+static void Sys_loco_print(int address, DCC_packet_T cached);
+static unsigned Sys_latency_bound_ms(uint8_t i);
+
+/**
+ * The real allocator, reached through the linker's --wrap option.
+ */
+extern void *__real_malloc(size_t size);
+extern void __real_free(void *ptr);
 
 extern void
 Sys_init(void)
@@ -35,21 +108,20 @@ Sys_init(void)
     Sys_parse_err_count = 0;
     Sys_parse_ok_count = 0;
     Sys_sys_cmd_count = 0;
+    Sys_link_frame_count = 0;
+    Sys_link_bad_frame_count = 0;
+    Sys_link_crc_error_count = 0;
+    Sys_link_rx_error_count = 0;
+    Sys_heap_cmd_allocs = 0;
+    Sys_heap_cmd_allocs_max = 0;
+    memset(&Sys_latency, 0, sizeof(Sys_latency));
 }
 
-extern T
-Sys_cmd_create(uint8_t type, void *args)
+extern void
+Sys_cmd_init(T cmd, uint8_t type, int arg)
 {
-    T cmd;
-
-    cmd = (T) malloc(sizeof(*cmd));
-    if(cmd == NULL)
-    {
-        return NULL;
-    }
-
     cmd->type = type;
-    cmd->args = args;
+    cmd->arg = arg;
     switch(cmd->type)
     {
         case SYS_CMD_TYPE_STATUS:
@@ -68,24 +140,41 @@ Sys_cmd_create(uint8_t type, void *args)
             cmd->call = Sys_cmd_cache_show;
             break;
 
-        default:
-            cmd->call = NULL;
+        case SYS_CMD_TYPE_MODE:
+            cmd->call = Sys_cmd_mode;
             break;
-    }
 
-    return cmd;
-}
+        case SYS_CMD_TYPE_CRC:
+            cmd->call = Sys_cmd_crc;
+            break;
 
-extern void
-Sys_cmd_destroy(T cmd, void (*free_args)(void *args))
-{
-    if(cmd)
-    {
-        if(cmd->args != NULL && free_args != NULL)
-        {
-            free_args(cmd->args);
-        }
-        free(cmd);
+        case SYS_CMD_TYPE_TIMING:
+            cmd->call = Sys_cmd_timing;
+            break;
+
+        case SYS_CMD_TYPE_BANDWIDTH:
+            cmd->call = Sys_cmd_bandwidth;
+            break;
+
+        case SYS_CMD_TYPE_LATENCY:
+            cmd->call = Sys_cmd_latency;
+            break;
+
+        case SYS_CMD_TYPE_TRACE_SHOW:
+            cmd->call = Sys_cmd_trace_show;
+            break;
+
+        case SYS_CMD_TYPE_TRACE:
+            cmd->call = Sys_cmd_trace;
+            break;
+
+        case SYS_CMD_TYPE_LOCOS:
+            cmd->call = Sys_cmd_locos;
+            break;
+
+        default:
+            cmd->call = NULL;
+            break;
     }
 }
 
@@ -114,75 +203,381 @@ Sys_parse_ok_increment(void)
     Sys_parse_ok_count++;
 }
 
+extern void
+Sys_link_increment(uint8_t event)
+{
+    switch(event)
+    {
+        case SYS_LINK_FRAME:
+            Sys_link_frame_count++;
+            break;
+
+        case SYS_LINK_BAD_FRAME:
+            Sys_link_bad_frame_count++;
+            break;
+
+        case SYS_LINK_CRC_ERROR:
+            Sys_link_crc_error_count++;
+            break;
+
+        case SYS_LINK_RX_ERROR:
+            Sys_link_rx_error_count++;
+            break;
+    }
+}
+
+extern void
+Sys_latency_record(uint16_t clocks)
+{
+    uint8_t i;
+
+    if(Sys_latency.count == 0 || clocks < Sys_latency.min)
+        Sys_latency.min = clocks;
+
+    if(clocks > Sys_latency.max)
+        Sys_latency.max = clocks;
+
+    Sys_latency.total += clocks;
+    Sys_latency.count++;
+
+    for(i=0; i < (SYS_LATENCY_BUCKETS - 1)
+        && clocks >= pgm_read_word(&Sys_latency_bounds[i]); i++)
+        ;
+
+    Sys_latency.hist[i]++;
+}
+
+extern void
+Sys_heap_mark(void)
+{
+    Sys_heap_mark_count = Sys_heap_alloc_count;
+}
+
+extern void
+Sys_heap_account(void)
+{
+    Sys_heap_cmd_allocs = Sys_heap_alloc_count - Sys_heap_mark_count;
+    if(Sys_heap_cmd_allocs > Sys_heap_cmd_allocs_max)
+        Sys_heap_cmd_allocs_max = Sys_heap_cmd_allocs;
+
+    /* The next line starts here. */
+    Sys_heap_mark_count = Sys_heap_alloc_count;
+}
+
+void *
+__wrap_malloc(size_t size)
+{
+    void *ptr;
+
+    Sys_heap_alloc_count++;
+    ptr = __real_malloc(size);
+    Hal_heap_note();
+
+    return ptr;
+}
+
+void
+__wrap_free(void *ptr)
+{
+    if(ptr)
+        Sys_heap_free_count++;
+
+    __real_free(ptr);
+}
+
 static void
-Sys_cmd_status(void *args)
+Sys_cmd_status(int arg)
 {
-    int v, mem_free, cache_total, cache_used;
-    double mem_free_percentage;
-    extern int __heap_start, *__brkval;
+    int cache_total, cache_used;
+    uint32_t uptime, rx_errors;
+    struct Hal_mem mem;
+
+    uptime = Clock_millis();
+
+    /* Free memory, and the stack and heap high water marks. */
+    Hal_mem_report(&mem);
 
-    /* Calculate free heap memory. */
-    mem_free = (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
-    mem_free_percentage = (mem_free / (double) SYS_TOT_MEM) * 100;
+    /* Receive errors are counted by the USART interrupt handler. */
+    HAL_IRQ_DISABLE();
+    rx_errors = Sys_link_rx_error_count;
+    HAL_IRQ_ENABLE();
+
+    if(IO_get_mode() == IO_MODE_MACHINE)
+    {
+        /* Every counter as key=value pairs on one line. */
+        printf_P(PSTR("status uptime_ms=%" PRIu32 " mem_free=%u stack_max=%u heap_max=%u"
+                      " heap_largest_free=%u mem_free_min=%u"),
+                 uptime, mem.free, mem.stack_max, mem.heap_max, mem.heap_largest,
+                 mem.free_min);
+        printf_P(PSTR(" heap_allocs=%" PRIu32 " heap_frees=%" PRIu32 " heap_cmd_allocs_max=%d"),
+                 Sys_heap_alloc_count, Sys_heap_free_count, Sys_heap_cmd_allocs_max);
+        printf_P(PSTR(" sys_cmds=%" PRIu32 " tx_packets=%" PRIu32 " tx_bytes=%" PRIu32
+                      " parse_ok=%" PRIu32 " parse_errors=%" PRIu32),
+                 Sys_sys_cmd_count, Sys_tx_count, Sys_tx_bytes_count,
+                 Sys_parse_ok_count, Sys_parse_err_count);
+        printf_P(PSTR(" link_frames=%" PRIu32 " link_bad_frames=%" PRIu32
+                      " link_crc_errors=%" PRIu32 " link_rx_errors=%" PRIu32),
+                 Sys_link_frame_count, Sys_link_bad_frame_count,
+                 Sys_link_crc_error_count, rx_errors);
+        printf_P(PSTR(" cache=%d/%d tx_queue=%d/%d rx_buffer=%d/%d pool_free=%d/%d\n"),
+                 Cache_report_current_size(), Cache_report_total_size(),
+                 Scheduler_report_current_size(), Scheduler_report_total_size(),
+                 IO_report_current_size(), IO_report_total_size(),
+                 DCC_pool_report_free(), DCC_POOL_SIZE);
+        return;
+    }
 
     /* Output all counters. */
     printf_P(PSTR("system details\n"));
-    printf_P(PSTR("  mem_used_bytes:\t%d\n"), (SYS_TOT_MEM - mem_free));
-    printf_P(PSTR("  mem_free_bytes:\t%d\n"), mem_free);
-    printf_P(PSTR("  mem_free_percent:\t%.2f%%\n"), mem_free_percentage);
-    printf_P(PSTR("  sys_cmd_total:\t%d\n"), Sys_sys_cmd_count);
-    printf_P(PSTR("  dcc_tx_packets:\t%d\n"), Sys_tx_count);
-    printf_P(PSTR("  dcc_tx_bytes:\t\t%d\n"), Sys_tx_bytes_count);
-    printf_P(PSTR("  parse_errors:\t\t%d\n"), Sys_parse_err_count);
-    printf_P(PSTR("  parse_ok:\t\t%d\n"), Sys_parse_ok_count);
-    printf_P(PSTR("  parse_total:\t\t%d\n"), (Sys_parse_ok_count + Sys_parse_err_count));
+    printf_P(PSTR("  uptime:\t\t%" PRIu32 "d %02u:%02u:%02u\n"), (uint32_t) (uptime / 86400000UL),
+             (unsigned) ((uptime / 3600000UL) % 24), (unsigned) ((uptime / 60000UL) % 60),
+             (unsigned) ((uptime / 1000UL) % 60));
+    printf_P(PSTR("  uptime_ms:\t\t%" PRIu32 "\n"), uptime);
+    printf_P(PSTR("  mem_used_bytes:\t%u\n"), (mem.total - mem.free));
+    printf_P(PSTR("  mem_free_bytes:\t%u\n"), mem.free);
+    printf_P(PSTR("  mem_free_percent:\t"));
+    print_percent(mem.free, mem.total);
+    printf_P(PSTR("\n"));
+    printf_P(PSTR("  stack_max_bytes:\t%u\n"), mem.stack_max);
+    printf_P(PSTR("  heap_max_bytes:\t%u\n"), mem.heap_max);
+    printf_P(PSTR("  heap_largest_free:\t%u\n"), mem.heap_largest);
+    printf_P(PSTR("  mem_free_min_bytes:\t%u\n"), mem.free_min);
+    printf_P(PSTR("  heap_allocs:\t\t%" PRIu32 "\n"), Sys_heap_alloc_count);
+    printf_P(PSTR("  heap_frees:\t\t%" PRIu32 "\n"), Sys_heap_free_count);
+    printf_P(PSTR("  heap_cmd_allocs:\t%d\n"), Sys_heap_cmd_allocs);
+    printf_P(PSTR("  heap_cmd_allocs_max:\t%d\n"), Sys_heap_cmd_allocs_max);
+    printf_P(PSTR("  sys_cmd_total:\t%" PRIu32 "\n"), Sys_sys_cmd_count);
+    printf_P(PSTR("  dcc_tx_packets:\t%" PRIu32 "\n"), Sys_tx_count);
+    printf_P(PSTR("  dcc_tx_bytes:\t\t%" PRIu32 "\n"), Sys_tx_bytes_count);
+    printf_P(PSTR("  parse_errors:\t\t%" PRIu32 "\n"), Sys_parse_err_count);
+    printf_P(PSTR("  parse_ok:\t\t%" PRIu32 "\n"), Sys_parse_ok_count);
+    printf_P(PSTR("  parse_total:\t\t%" PRIu32 "\n"), (Sys_parse_ok_count + Sys_parse_err_count));
+    printf_P(PSTR("  link_frames:\t\t%" PRIu32 "\n"), Sys_link_frame_count);
+    printf_P(PSTR("  link_bad_frames:\t%" PRIu32 "\n"), Sys_link_bad_frame_count);
+    printf_P(PSTR("  link_crc_errors:\t%" PRIu32 "\n"), Sys_link_crc_error_count);
+    printf_P(PSTR("  link_rx_errors:\t%" PRIu32 "\n"), rx_errors);
+    printf_P(PSTR("  link_error_percent:\t"));
+    print_percent(Sys_link_bad_frame_count, Sys_link_frame_count);
+    printf_P(PSTR("\n"));
     printf_P(PSTR("  cache_used:\t\t%d/%d\n"), (cache_used = Cache_report_current_size()),
              (cache_total = Cache_report_total_size()));
-    printf_P(PSTR("  cache_free_percent:\t%.2f%%\n\n"),
-             ((cache_total - cache_used) / (double) cache_total) * 100);
+    printf_P(PSTR("  cache_free_percent:\t"));
+    print_percent(cache_total - cache_used, cache_total);
+    printf_P(PSTR("\n"));
+    printf_P(PSTR("  tx_queue_used:\t%d/%d\n"), Scheduler_report_current_size(),
+             Scheduler_report_total_size());
+    printf_P(PSTR("  rx_buffer_used:\t%d/%d\n"), IO_report_current_size(),
+             IO_report_total_size());
+    printf_P(PSTR("  packet_pool_free:\t%d/%d\n\n"), DCC_pool_report_free(), DCC_POOL_SIZE);
 }
 
 static void
-Sys_cmd_help(void *args)
+Sys_cmd_help(int arg)
 {
     printf_P(PSTR("system help message goes here...\n\n"));
 }
 
 static void
-Sys_cmd_cache_clear(void *args)
+Sys_cmd_cache_clear(int arg)
 {
     int curr;
     curr = Cache_report_current_size();
+
+    /* The cache is shared with the scheduler interrupt. */
+    HAL_IRQ_DISABLE();
     Cache_clear();
+    HAL_IRQ_ENABLE();
+
     printf_P(PSTR("%d item(s) purged\n\n"), curr);
 }
 
 static void
-Sys_cmd_cache_show(void *args)
+Sys_cmd_cache_show(int address)
 {
-    int *address = (int*) args;
-    char *hex_dump, *binary_dump;
+    struct DCC_packet_T copy;
     DCC_packet_T cached;
 
-    if((cached = Cache_get(*address)) == NULL)
+    /* The scheduler may replace the cached packet as we print. */
+    HAL_IRQ_DISABLE();
+    if((cached = Cache_get(address)) != NULL)
     {
-        printf_P(PSTR("no cached packet for loco with address %d\n\n"), *address);
+        copy = *cached;
+        cached = &copy;
+    }
+    HAL_IRQ_ENABLE();
+
+    if(IO_get_mode() == IO_MODE_MACHINE)
+    {
+        Sys_loco_print(address, cached);
+        return;
+    }
+
+    if(cached == NULL)
+    {
+        printf_P(PSTR("no cached packet for loco with address %d\n\n"), address);
     }
     else
     {
-        hex_dump = DCC_hex_dump(cached);
-        binary_dump = DCC_dump(cached);
         printf_P(PSTR("cached packet details\n"));
-        printf_P(PSTR("  address:\t%d\n"), *address);
+        printf_P(PSTR("  address:\t%d\n"), address);
         printf_P(PSTR("  speed:\t%d\n"), DCC_get_speed_step(cached));
         printf_P(PSTR("  direction:\t%s\n"), (DCC_get_direction(cached) ? "forward" : "reverse"));
-        printf_P(PSTR("  hex:\t\t%s\n"), hex_dump);
-        printf_P(PSTR("  binary:\t%s\n\n"), binary_dump);
+        printf_P(PSTR("  hex:\t\t"));
+        DCC_packet_dump_hex(cached);
+        printf_P(PSTR("\n  binary:\t"));
+        DCC_packet_dump(cached);
+        printf_P(PSTR("\n\n"));
+    }
+}
+
+static void
+Sys_cmd_mode(int mode)
+{
+    IO_set_mode(mode);
+}
 
-        if(hex_dump)
-            free(hex_dump);
+static void
+Sys_cmd_crc(int enable)
+{
+    IO_set_crc(enable);
+}
 
-        if(binary_dump)
-            free(binary_dump);
+static void
+Sys_cmd_timing(int arg)
+{
+    Timing_report(IO_get_mode() == IO_MODE_MACHINE);
+}
+
+static void
+Sys_cmd_bandwidth(int arg)
+{
+    Scheduler_report_bandwidth(IO_get_mode() == IO_MODE_MACHINE);
+}
+
+static void
+Sys_cmd_latency(int arg)
+{
+    struct Sys_latency latency;
+    int i;
+
+    /* The scheduler records latencies as we go. */
+    HAL_IRQ_DISABLE();
+    latency = Sys_latency;
+    HAL_IRQ_ENABLE();
+
+    if(IO_get_mode() == IO_MODE_MACHINE)
+    {
+        printf_P(PSTR("latency packets=%" PRIu32 " min_us=%" PRIu32 " max_us=%" PRIu32
+                      " mean_us=%" PRIu32 " hist_ms="),
+                 latency.count, SYS_CLOCKS_US(latency.min), SYS_CLOCKS_US(latency.max),
+                 (latency.count == 0 ? 0 : SYS_CLOCKS_US(latency.total / latency.count)));
+        for(i=0; i < (SYS_LATENCY_BUCKETS - 1); i++)
+            printf_P(PSTR("<%u:%u,"), Sys_latency_bound_ms(i), latency.hist[i]);
+        printf_P(PSTR(">=%u:%u\n"), Sys_latency_bound_ms(i - 1), latency.hist[i]);
+        return;
+    }
+
+    printf_P(PSTR("latency details (parse to track)\n"));
+    printf_P(PSTR("  packets:\t%" PRIu32 "\n"), latency.count);
+    printf_P(PSTR("  min_us:\t%" PRIu32 "\n"), SYS_CLOCKS_US(latency.min));
+    printf_P(PSTR("  max_us:\t%" PRIu32 "\n"), SYS_CLOCKS_US(latency.max));
+    printf_P(PSTR("  mean_us:\t%" PRIu32 "\n"), (latency.count == 0 ? 0
+             : SYS_CLOCKS_US(latency.total / latency.count)));
+    printf_P(PSTR("  hist_ms:\t"));
+    for(i=0; i < (SYS_LATENCY_BUCKETS - 1); i++)
+    {
+        printf_P(PSTR("<%u:%u "), Sys_latency_bound_ms(i), latency.hist[i]);
     }
+    printf_P(PSTR(">=%u:%u\n\n"), Sys_latency_bound_ms(i - 1), latency.hist[i]);
+}
+
+static void
+Sys_cmd_trace_show(int arg)
+{
+    Trace_dump(IO_get_mode() == IO_MODE_MACHINE);
+}
+
+static void
+Sys_cmd_trace(int enable)
+{
+    Trace_set_stream(enable);
+}
+
+static void
+Sys_cmd_locos(int arg)
+{
+    struct DCC_packet_T copy;
+    DCC_packet_T cached;
+    int addresses[CONFIG_CACHE_SIZE], i, n;
+
+    /*
+     * The scheduler rotates the refresh order with every packet, so take
+     * the addresses in one go rather than as the slow output goes.
+     */
+    HAL_IRQ_DISABLE();
+    n = Cache_report_current_size();
+    for(i=0; i < n; i++)
+        addresses[i] = Cache_report_address(i);
+    HAL_IRQ_ENABLE();
+
+    if(IO_get_mode() == IO_MODE_HUMAN)
+        printf_P(PSTR("cached locos\n  address\tspeed\tdirection\thex\n"));
+
+    for(i=0; i < n; i++)
+    {
+        /* The scheduler replaces cached packets as we go. */
+        HAL_IRQ_DISABLE();
+        if((cached = Cache_get(addresses[i])) != NULL)
+        {
+            copy = *cached;
+            cached = &copy;
+        }
+        HAL_IRQ_ENABLE();
+
+        if(IO_get_mode() == IO_MODE_MACHINE)
+        {
+            Sys_loco_print(addresses[i], cached);
+        }
+        else if(cached != NULL)
+        {
+            printf_P(PSTR("  %d\t\t%d\t%S\t\t"), addresses[i], DCC_get_speed_step(cached),
+                     (DCC_get_direction(cached) ? PSTR("forward") : PSTR("reverse")));
+            DCC_packet_dump_hex(cached);
+            printf_P(PSTR("\n"));
+        }
+    }
+
+    if(IO_get_mode() == IO_MODE_HUMAN)
+        printf_P(PSTR("\n"));
+}
+
+/**
+ * Print the cached state of a loco as a machine mode key=value line.
+ */
+static void
+Sys_loco_print(int address, DCC_packet_T cached)
+{
+    int i;
+
+    printf_P(PSTR("loco addr=%d"), address);
+    if(cached == NULL)
+    {
+        printf_P(PSTR(" cached=0\n"));
+        return;
+    }
+
+    printf_P(PSTR(" cached=1 speed=%d dir=%d hex="), DCC_get_speed_step(cached),
+             DCC_get_direction(cached));
+    for(i=0; i < cached->size; i++)
+        printf_P(PSTR("%02x"), cached->bytes[i]);
+    printf_P(PSTR("\n"));
+}
+
+/**
+ * Return a latency histogram bound in whole milliseconds.
+ */
+static unsigned
+Sys_latency_bound_ms(uint8_t i)
+{
+    return (unsigned) (SYS_CLOCKS_US(pgm_read_word(&Sys_latency_bounds[i])) / 1000);
 }
@@ -8,6 +8,8 @@
 #ifndef DEFINED_SYS
 #define DEFINED_SYS
 
+#include <stdint.h>
+
 #include "dcc.h"
 
 #define T                        Sys_cmd_T
@@ -15,22 +17,60 @@
 #define SYS_CMD_TYPE_HELP        0x02
 #define SYS_CMD_TYPE_CACHE_CLEAR 0x03
 #define SYS_CMD_TYPE_CACHE_SHOW  0x04
+#define SYS_CMD_TYPE_MODE        0x05
+#define SYS_CMD_TYPE_CRC         0x06
+#define SYS_CMD_TYPE_TIMING      0x07
+#define SYS_CMD_TYPE_BANDWIDTH   0x08
+#define SYS_CMD_TYPE_LATENCY     0x09
+#define SYS_CMD_TYPE_TRACE_SHOW  0x0A
+#define SYS_CMD_TYPE_TRACE       0x0B
+#define SYS_CMD_TYPE_LOCOS       0x0C
+
+/*
+ * Serial link events.
+ */
+#define SYS_LINK_FRAME           0  /**< A line was received. */
+#define SYS_LINK_BAD_FRAME       1  /**< A line was discarded as corrupt. */
+#define SYS_LINK_CRC_ERROR       2  /**< A line failed its CRC check. */
+#define SYS_LINK_RX_ERROR        3  /**< Input was lost to a USART error or full buffer. */
 
+/**
+ * A system command. Commands are stored inline in the parser result, so
+ * the single argument is held by value.
+ */
 typedef struct T *T;
 struct T
 {
     uint8_t type;
-    void (*call)(void *args);
-    void *args;
+    void (*call)(int arg);
+    int arg;
 };
 
 extern void Sys_init(void);
-extern T Sys_cmd_create(uint8_t type, void *args);
-extern void Sys_cmd_destroy(T cmd, void (*free_args)(void *args));
+extern void Sys_cmd_init(T cmd, uint8_t type, int arg);
 extern void Sys_process_dcc_tx(DCC_packet_T packet);
 extern void Sys_process_sys_cmd(T cmd);
 extern void Sys_parse_err_increment(void);
 extern void Sys_parse_ok_increment(void);
+extern void Sys_link_increment(uint8_t event);
+
+/**
+ * Record the delay between a packet being parsed and its first
+ * transmission, called by the scheduler interrupt handler.
+ *
+ * @param clocks The latency in scheduler clock counts, see Scheduler_now().
+ */
+extern void Sys_latency_record(uint16_t clocks);
+
+/**
+ * Heap churn accounting. Every malloc and free in the firmware is counted
+ * (see the --wrap linker options in the Makefile). The IO module accounts
+ * for each line once its command has been dispatched, which also marks the
+ * counter for the next line, so the allocations made per command are known
+ * without any work per character. A mark starts the count afresh.
+ */
+extern void Sys_heap_mark(void);
+extern void Sys_heap_account(void);
 
 #undef T
 #endif
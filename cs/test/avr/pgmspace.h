@@ -0,0 +1,24 @@
+/**
+ * @file pgmspace.h
+ * @brief Host stand-in for the avr-libc program space API.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * On the host there is a single address space, so flash strings are
+ * ordinary strings and the _P functions map onto their libc equivalents.
+ */
+
+#ifndef TEST_PGMSPACE_DEFINED
+#define TEST_PGMSPACE_DEFINED
+
+#include <string.h>
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)             (s)
+#define strlen_P            strlen
+#define strncmp_P           strncmp
+#define printf_P            printf
+#define pgm_read_byte(p)    (*(const uint8_t *) (p))
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file check.c
+ * @brief Runs the host unit tests.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+
+int Check_total;
+int Check_failed;
+
+static const struct
+{
+    const char *name;
+    void (*run)(void);
+} Check_suites[] = {
+    { "dcc",   Check_dcc },
+    { "ring",  Check_ring },
+    { "hash",  Check_hash },
+    { "cache", Check_cache },
+    { "dsl",   Check_dsl },
+    { "signal", Check_signal },
+    { "sys",   Check_sys },
+    { "io",    Check_io },
+    { "trace", Check_trace },
+    { "utils", Check_utils }
+};
+
+#define CHECK_NUM_SUITES (sizeof(Check_suites) / sizeof(Check_suites[0]))
+
+int
+main(void)
+{
+    int i, total, failed;
+
+    for(i=0; i < CHECK_NUM_SUITES; i++)
+    {
+        total = Check_total;
+        failed = Check_failed;
+
+        Check_suites[i].run();
+
+        printf("  %-8s %4d checks, %d failed\n", Check_suites[i].name,
+            Check_total - total, Check_failed - failed);
+    }
+
+    printf("%d checks, %d failed\n", Check_total, Check_failed);
+
+    return (Check_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
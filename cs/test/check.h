@@ -0,0 +1,58 @@
+/**
+ * @file check.h
+ * @brief Assertion macros for the host unit tests.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The tests link against the modules of the native build (see hal_posix.h)
+ * and run with make check. A failed check is reported with its location
+ * and the test carries on, so one run lists every failure.
+ */
+
+#ifndef CHECK_DEFINED
+#define CHECK_DEFINED
+
+#include <stdio.h>
+
+extern int Check_total;
+extern int Check_failed;
+
+/** Check that a condition holds. */
+#define CHECK(cond) \
+    do { \
+        Check_total++; \
+        if(!(cond)) \
+        { \
+            Check_failed++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while(0)
+
+/** Check that two integers are equal, reporting both if not. */
+#define CHECK_INT(a, b) \
+    do { \
+        long check_a_ = (long) (a), check_b_ = (long) (b); \
+        Check_total++; \
+        if(check_a_ != check_b_) \
+        { \
+            Check_failed++; \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%ld != %ld)\n", \
+                __FILE__, __LINE__, #a, #b, check_a_, check_b_); \
+        } \
+    } while(0)
+
+/*
+ * The test suites, one per module.
+ */
+extern void Check_dcc(void);
+extern void Check_ring(void);
+extern void Check_hash(void);
+extern void Check_cache(void);
+extern void Check_dsl(void);
+extern void Check_signal(void);
+extern void Check_sys(void);
+extern void Check_io(void);
+extern void Check_trace(void);
+extern void Check_utils(void);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file check_cache.c
+ * @brief Tests the refresh cache module.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include "check.h"
+#include "cache.h"
+
+static DCC_packet_T
+Check_cache_loco(int address, int step)
+{
+    DCC_packet_T packet = DCC_baseline_packet_create();
+
+    DCC_set_preamble(packet);
+    DCC_set_address(packet, address);
+    DCC_set_speed_direction_preamble(packet);
+    DCC_set_direction(packet, DCC_DIRECTION_FORWARD);
+    DCC_set_speed(packet, step);
+    DCC_set_checksum(packet);
+    DCC_set_packet_end(packet);
+
+    return packet;
+}
+
+extern void
+Check_cache(void)
+{
+    int nfree = DCC_pool_report_free(), addresses[] = { 3, 10, 27, 3 + CONFIG_CACHE_SIZE }, i;
+    DCC_packet_T packet;
+
+    Cache_module_init();
+    CHECK(Cache_get_next_packet() == NULL);
+    CHECK_INT(Cache_report_current_size(), 0);
+    CHECK_INT(Cache_report_total_size(), CONFIG_CACHE_SIZE);
+
+    /* Locos are refreshed round robin, in the order first seen. */
+    for(i=0; i < 4; i++)
+        Cache_update(Check_cache_loco(addresses[i], i + 1));
+    CHECK_INT(Cache_report_current_size(), 4);
+    for(i=0; i < 4; i++)
+        CHECK_INT(Cache_report_address(i), addresses[i]);
+    for(i=0; i < 9; i++)
+        CHECK_INT(DCC_get_address(Cache_get_next_packet()), addresses[i % 4]);
+
+    /* The next refresh is the second loco. */
+    CHECK_INT(Cache_report_address(0), addresses[1]);
+
+    /* Updating a loco replaces its packet without moving it. */
+    packet = Check_cache_loco(27, 20);
+    Cache_update(packet);
+    CHECK_INT(Cache_report_current_size(), 4);
+    CHECK(Cache_get(27) == packet);
+    CHECK_INT(DCC_pool_report_free(), nfree - 4);
+    CHECK_INT(DCC_get_address(Cache_get_next_packet()), 10);
+    CHECK(Cache_get_next_packet() == packet);
+
+    /* The first and last locos share a slot in the table. */
+    CHECK_INT(DCC_get_speed_step(Cache_get(3)), 1);
+    CHECK_INT(DCC_get_speed_step(Cache_get(3 + CONFIG_CACHE_SIZE)), 4);
+    CHECK(Cache_get(5) == NULL);
+
+    /* Clearing returns every packet to the pool. */
+    Cache_clear();
+    CHECK_INT(Cache_report_current_size(), 0);
+    CHECK(Cache_get_next_packet() == NULL);
+    CHECK(Cache_get(3) == NULL);
+    CHECK_INT(DCC_pool_report_free(), nfree);
+
+    /* A full cache. */
+    for(i=0; i < CONFIG_CACHE_SIZE; i++)
+        Cache_update(Check_cache_loco(i + 1, 1));
+    CHECK_INT(Cache_report_current_size(), CONFIG_CACHE_SIZE);
+    for(i=0; i < CONFIG_CACHE_SIZE; i++)
+        CHECK_INT(DCC_get_address(Cache_get(i + 1)), i + 1);
+    for(i=0; i < CONFIG_CACHE_SIZE; i++)
+        CHECK_INT(DCC_get_address(Cache_get_next_packet()), i + 1);
+
+    Cache_clear();
+    CHECK_INT(DCC_pool_report_free(), nfree);
+}
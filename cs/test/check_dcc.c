@@ -0,0 +1,270 @@
+/**
+ * @file check_dcc.c
+ * @brief Tests the DCC packet module.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <string.h>
+
+#include "check.h"
+#include "dcc.h"
+
+/**
+ * Read a packet as a decoder would, into its address, instruction and
+ * error detection bytes.
+ *
+ * @return The number of bytes, or -1 if the packet is not framed with at
+ *  least DCC_PREAMBLE_BITS of preamble and an end bit.
+ */
+static int
+Check_dcc_frame(DCC_packet_T packet, unsigned char *bytes, int max)
+{
+    int bit = 0, bits = packet->size * 8, n = 0, i;
+
+#define CHECK_DCC_BIT(b) ((packet->bytes[(b) / 8] >> (7 - ((b) % 8))) & 1)
+
+    while(bit < bits && CHECK_DCC_BIT(bit))
+        bit++;
+
+    if(bit < DCC_PREAMBLE_BITS)
+        return -1;
+
+    /* Each byte follows a zero, and the packet ends with a one. */
+    while(bit < bits && CHECK_DCC_BIT(bit) == 0)
+    {
+        if(n == max || (bit + 9) >= bits)
+            return -1;
+
+        bytes[n] = 0;
+        for(i=1; i <= 8; i++)
+            bytes[n] = (bytes[n] << 1) | CHECK_DCC_BIT(bit + i);
+
+        n++;
+        bit += 9;
+    }
+
+#undef CHECK_DCC_BIT
+
+    return (bit < bits ? n : -1);
+}
+
+static DCC_packet_T
+Check_dcc_loco(int address, int direction, int step)
+{
+    DCC_packet_T packet = DCC_baseline_packet_create();
+
+    DCC_set_preamble(packet);
+    DCC_set_address(packet, address);
+    DCC_set_speed_direction_preamble(packet);
+    DCC_set_direction(packet, direction);
+    DCC_set_speed(packet, step);
+    DCC_set_checksum(packet);
+    DCC_set_packet_end(packet);
+
+    return packet;
+}
+
+static void
+Check_dcc_address(void)
+{
+    DCC_packet_T packet;
+    int address;
+
+    for(address = 0; address < DCC_ADDRESS_MAX; address++)
+    {
+        packet = Check_dcc_loco(address, DCC_DIRECTION_FORWARD, 5);
+        CHECK_INT(DCC_get_address(packet), address);
+        CHECK_INT(DCC_get_speed_step(packet), 5);
+        DCC_packet_destroy(packet);
+    }
+
+    /* Addresses wrap, and setting one leaves the rest of the packet. */
+    packet = Check_dcc_loco(3, DCC_DIRECTION_REVERSE, 12);
+    DCC_set_address(packet, DCC_ADDRESS_MAX + 9);
+    CHECK_INT(DCC_get_address(packet), 9);
+    CHECK_INT(DCC_get_direction(packet), DCC_DIRECTION_REVERSE);
+    CHECK_INT(DCC_get_speed_step(packet), 12);
+    DCC_set_address(packet, 127);
+    DCC_set_address(packet, 0);
+    CHECK_INT(DCC_get_address(packet), 0);
+    DCC_packet_destroy(packet);
+}
+
+static void
+Check_dcc_speed_direction(void)
+{
+    DCC_packet_T packet = Check_dcc_loco(10, DCC_DIRECTION_FORWARD, 0);
+    int step;
+
+    for(step = 0; step < DCC_MAX_SPEED_STEPS; step++)
+    {
+        DCC_set_speed(packet, step);
+        CHECK_INT(DCC_get_speed_step(packet), step);
+        CHECK_INT(DCC_get_direction(packet), DCC_DIRECTION_FORWARD);
+        CHECK_INT(DCC_get_address(packet), 10);
+    }
+
+    /* Steps wrap to stop. */
+    DCC_set_speed(packet, DCC_MAX_SPEED_STEPS);
+    CHECK_INT(DCC_get_speed_step(packet), 0);
+
+    DCC_set_speed(packet, 6);
+    DCC_set_direction(packet, DCC_DIRECTION_REVERSE);
+    CHECK_INT(DCC_get_direction(packet), DCC_DIRECTION_REVERSE);
+    CHECK_INT(DCC_get_speed_step(packet), 6);
+    DCC_set_direction(packet, DCC_DIRECTION_FORWARD);
+    CHECK_INT(DCC_get_direction(packet), DCC_DIRECTION_FORWARD);
+    CHECK_INT(DCC_get_speed_step(packet), 6);
+
+    /* The instruction is 01DCSSSS, with step 6 as C = 1, SSSS = 0100. */
+    CHECK_INT(DCC_get_speed_and_direction(packet), 0x74);
+    DCC_set_direction(packet, DCC_DIRECTION_REVERSE);
+    CHECK_INT(DCC_get_speed_and_direction(packet), 0x54);
+    DCC_set_speed(packet, 1);
+    CHECK_INT(DCC_get_speed_and_direction(packet), 0x42);
+
+    DCC_packet_destroy(packet);
+}
+
+static void
+Check_dcc_framing(void)
+{
+    unsigned char data[2] = { 0x03, 0x74 }, bytes[8];
+    DCC_packet_T baseline, framed;
+
+    /* A baseline packet reads back as address, instruction and check. */
+    baseline = Check_dcc_loco(3, DCC_DIRECTION_FORWARD, 6);
+    CHECK_INT(Check_dcc_frame(baseline, bytes, sizeof(bytes)), 3);
+    CHECK_INT(bytes[0], 0x03);
+    CHECK_INT(bytes[1], 0x74);
+    CHECK_INT(bytes[2], 0x03 ^ 0x74);
+
+    /* Framing the same data gives the same bits. */
+    framed = DCC_framed_packet_create(data, 2);
+    CHECK(framed != NULL);
+    CHECK_INT(framed->size, DCC_FRAMED_SIZE(2));
+    CHECK(memcmp(framed->bytes, baseline->bytes, baseline->size) == 0);
+    CHECK_INT(DCC_get_address(framed), 3);
+    CHECK_INT(DCC_get_speed_step(framed), 6);
+    DCC_packet_destroy(framed);
+    DCC_packet_destroy(baseline);
+
+    /* Longer packets, up to the largest that fits. */
+    data[0] = 0xC1;
+    framed = DCC_framed_packet_create(data, 1);
+    CHECK_INT(Check_dcc_frame(framed, bytes, sizeof(bytes)), 2);
+    CHECK_INT(bytes[0], 0xC1);
+    CHECK_INT(bytes[1], 0xC1);
+    DCC_packet_destroy(framed);
+
+    CHECK(DCC_framed_packet_create(data, 0) == NULL);
+    CHECK(DCC_FRAMED_SIZE(DCC_MAX_PACKET_SIZE) > DCC_MAX_PACKET_SIZE);
+    CHECK(DCC_packet_create(DCC_MAX_PACKET_SIZE + 1) == NULL);
+}
+
+static void
+Check_dcc_special(void)
+{
+    DCC_packet_T packet = DCC_baseline_packet_create();
+    unsigned char bytes[8];
+
+    DCC_special_idle_packet(packet);
+    CHECK(!DCC_is_broadcast_stop(packet));
+    CHECK_INT(Check_dcc_frame(packet, bytes, sizeof(bytes)), 3);
+    CHECK_INT(bytes[0], 0xFF);
+    CHECK_INT(bytes[1], 0x00);
+    CHECK_INT(bytes[2], 0xFF);
+
+    DCC_special_reset_packet(packet);
+    CHECK(!DCC_is_broadcast_stop(packet));
+    CHECK_INT(Check_dcc_frame(packet, bytes, sizeof(bytes)), 3);
+    CHECK_INT(bytes[0] | bytes[1] | bytes[2], 0);
+
+    DCC_special_broadcast_stop_packet(packet);
+    CHECK(DCC_is_broadcast_stop(packet));
+    CHECK_INT(Check_dcc_frame(packet, bytes, sizeof(bytes)), 3);
+    CHECK_INT(bytes[0], 0x00);
+    CHECK_INT(bytes[2], bytes[0] ^ bytes[1]);
+
+    DCC_special_emergency_stop_packet(packet);
+    CHECK(DCC_is_broadcast_stop(packet));
+    CHECK_INT(Check_dcc_frame(packet, bytes, sizeof(bytes)), 3);
+    CHECK_INT(bytes[2], bytes[0] ^ bytes[1]);
+
+    DCC_packet_destroy(packet);
+}
+
+static void
+Check_dcc_compare(void)
+{
+    DCC_packet_T slow = Check_dcc_loco(3, DCC_DIRECTION_FORWARD, 4);
+    DCC_packet_T fast = Check_dcc_loco(3, DCC_DIRECTION_REVERSE, 20);
+
+    CHECK_INT(DCC_compare_speed(slow, fast), -1);
+    CHECK_INT(DCC_compare_speed(fast, slow), 1);
+    CHECK_INT(DCC_compare_speed(slow, slow), 0);
+
+    DCC_packet_destroy(slow);
+    DCC_packet_destroy(fast);
+}
+
+static void
+Check_dcc_pool(void)
+{
+    DCC_packet_T packets[DCC_POOL_SIZE];
+    struct DCC_packet_T copy;
+    int nfree = DCC_pool_report_free(), i;
+
+    /* Exhausting the pool fails cleanly, and every packet comes back. */
+    for(i=0; i < nfree; i++)
+        CHECK((packets[i] = DCC_baseline_packet_create()) != NULL);
+
+    CHECK_INT(DCC_pool_report_free(), 0);
+    CHECK(DCC_baseline_packet_create() == NULL);
+
+    for(i=0; i < nfree; i++)
+        DCC_packet_destroy(packets[i]);
+
+    CHECK_INT(DCC_pool_report_free(), nfree);
+
+    /* Fresh packets are cleared. */
+    packets[0] = DCC_packet_create(3);
+    CHECK_INT(packets[0]->size, 3);
+    CHECK_INT(packets[0]->seq, DCC_SEQ_NONE);
+    CHECK_INT(packets[0]->bytes[0] | packets[0]->bytes[DCC_MAX_PACKET_SIZE - 1], 0);
+    DCC_packet_destroy(packets[0]);
+
+    /* Destroying a packet twice, or one not from the pool, is ignored. */
+    DCC_packet_destroy(packets[0]);
+    CHECK_INT(DCC_pool_report_free(), nfree);
+    DCC_packet_destroy(&copy);
+    DCC_packet_destroy((DCC_packet_T) ((char *) packets[0] + 1));
+    CHECK_INT(DCC_pool_report_free(), nfree);
+
+    /* Each packet is still handed out once. */
+    for(i=0; i < nfree; i++)
+        CHECK((packets[i] = DCC_baseline_packet_create()) != NULL);
+    for(i=1; i < nfree; i++)
+        CHECK(packets[i] != packets[i - 1]);
+    CHECK(DCC_baseline_packet_create() == NULL);
+
+    for(i=0; i < nfree; i++)
+        DCC_packet_destroy(packets[i]);
+    CHECK_INT(DCC_pool_report_free(), nfree);
+}
+
+extern void
+Check_dcc(void)
+{
+    int nfree = DCC_pool_report_free();
+
+    Check_dcc_address();
+    Check_dcc_speed_direction();
+    Check_dcc_framing();
+    Check_dcc_special();
+    Check_dcc_compare();
+    Check_dcc_pool();
+
+    CHECK_INT(DCC_pool_report_free(), nfree);
+}
@@ -0,0 +1,260 @@
+/**
+ * @file check_dsl.c
+ * @brief Tests the DSL scanner and parser.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <string.h>
+#include <limits.h>
+
+#include "check.h"
+#include "dsl.h"
+#include "io.h"
+
+/**
+ * Lines the grammar accepts, with the result type each gives.
+ */
+static const struct
+{
+    const char *line;
+    int type;
+} Check_dsl_accepted[] = {
+    { "forward addr 3 speed 5\n",           DSL_RES_TYPE_DCC },
+    { "forward speed 5 addr 3\n",           DSL_RES_TYPE_DCC },
+    { "reverse addr 127 speed 28\n",        DSL_RES_TYPE_DCC },
+    { "FORWARD Addr 3 SPEED 5\n",           DSL_RES_TYPE_DCC },
+    { " \tforward  addr 3\tspeed 05 \r\n",  DSL_RES_TYPE_DCC },
+    { "stop\n",                             DSL_RES_TYPE_DCC },
+    { "stop all\n",                         DSL_RES_TYPE_DCC },
+    { "stop addr 10\n",                     DSL_RES_TYPE_DCC },
+    { "forward addr 3 speed 5;",            DSL_RES_TYPE_DCC },
+    { "#12 stop addr 10\n",                 DSL_RES_TYPE_DCC },
+    { "raw 0xdeadbeef\n",                   DSL_RES_TYPE_RAW },
+    { "raw 0XFFF0\n",                       DSL_RES_TYPE_RAW },
+    { "rawdata 0x0374\n",                   DSL_RES_TYPE_DATA },
+    { "help\n",                             DSL_RES_TYPE_SYS },
+    { "show status\n",                      DSL_RES_TYPE_SYS },
+    { "show timing\n",                      DSL_RES_TYPE_SYS },
+    { "show bandwidth\n",                   DSL_RES_TYPE_SYS },
+    { "show latency\n",                     DSL_RES_TYPE_SYS },
+    { "show trace\n",                       DSL_RES_TYPE_SYS },
+    { "show locos\n",                       DSL_RES_TYPE_SYS },
+    { "cache clear\n",                      DSL_RES_TYPE_SYS },
+    { "cache show 3\n",                     DSL_RES_TYPE_SYS },
+    { "mode machine\n",                     DSL_RES_TYPE_SYS },
+    { "mode human\n",                       DSL_RES_TYPE_SYS },
+    { "crc on\n",                           DSL_RES_TYPE_SYS },
+    { "crc off\n",                          DSL_RES_TYPE_SYS },
+    { "trace on\n",                         DSL_RES_TYPE_SYS },
+    { "trace off\n",                        DSL_RES_TYPE_SYS },
+    { "#0 help\n",                          DSL_RES_TYPE_SYS }
+};
+
+/**
+ * Lines the grammar rejects.
+ */
+static const char *Check_dsl_rejected[] = {
+    "forward addr 3\n",
+    "forward speed 5\n",
+    "forward addr speed 5\n",
+    "forward addr 3 speed 5 addr 4\n",
+    "forwards addr 3 speed 5\n",
+    "forward addr 3 speed 5 $\n",
+    "stop addr\n",
+    "stop addr 3 speed 5\n",
+    "stop none\n",
+    "show\n",
+    "show cache\n",
+    "cache\n",
+    "cache show\n",
+    "mode\n",
+    "crc\n",
+    "trace maybe\n",
+    "raw\n",
+    "raw 0x\n",
+    "raw 0x123\n",
+    "raw 12\n",
+    "raw 0xzz\n",
+    "rawdata\n",
+    "help help\n",
+    "#\n",
+    "# help\n",
+    "#12\n",
+    "help #12\n",
+    "12 help\n",
+    "forwardaddressspeedreverse\n",
+    "forward addr 3 reverse\n",
+    "forward speed 5 stop\n",
+    "raw help\n",
+    "help help help help help help help help help\n"
+};
+
+#define CHECK_DSL_NUM_ACCEPTED (sizeof(Check_dsl_accepted) / sizeof(Check_dsl_accepted[0]))
+#define CHECK_DSL_NUM_REJECTED (sizeof(Check_dsl_rejected) / sizeof(Check_dsl_rejected[0]))
+
+/**
+ * Feed a line to the parser, checking it only completes on its last
+ * character.
+ */
+static int
+Check_dsl_parse(const char *line, struct DSL_result_T *result)
+{
+    int status = DSL_PARSE_PENDING;
+
+    while(*line != '\0')
+    {
+        CHECK_INT(status, DSL_PARSE_PENDING);
+        status = DSL_parser_feed(*line++, result);
+    }
+
+    return status;
+}
+
+static void
+Check_dsl_release(struct DSL_result_T *result)
+{
+    if(result->type != DSL_RES_TYPE_SYS && result->type != DSL_RES_TYPE_UNDEF)
+        DCC_packet_destroy(result->payload.packet);
+}
+
+static void
+Check_dsl_grammar(void)
+{
+    struct DSL_result_T result;
+    int i, status;
+
+    for(i=0; i < CHECK_DSL_NUM_ACCEPTED; i++)
+    {
+        status = Check_dsl_parse(Check_dsl_accepted[i].line, &result);
+        if(status != DSL_PARSE_OK)
+            fprintf(stderr, "rejected: %s", Check_dsl_accepted[i].line);
+        CHECK_INT(status, DSL_PARSE_OK);
+        CHECK_INT(result.type, Check_dsl_accepted[i].type);
+        Check_dsl_release(&result);
+
+        /* A syntax check alone gives the same answer. */
+        CHECK_INT(Check_dsl_parse(Check_dsl_accepted[i].line, NULL), DSL_PARSE_OK);
+    }
+
+    for(i=0; i < CHECK_DSL_NUM_REJECTED; i++)
+    {
+        status = Check_dsl_parse(Check_dsl_rejected[i], &result);
+        if(status != DSL_PARSE_ERROR)
+            fprintf(stderr, "accepted: %s", Check_dsl_rejected[i]);
+        CHECK_INT(status, DSL_PARSE_ERROR);
+        CHECK_INT(result.type, DSL_RES_TYPE_UNDEF);
+        CHECK_INT(Check_dsl_parse(Check_dsl_rejected[i], NULL), DSL_PARSE_ERROR);
+    }
+
+    /* Blank lines. */
+    CHECK_INT(Check_dsl_parse("\n", &result), DSL_PARSE_EMPTY);
+    CHECK_INT(Check_dsl_parse(" \t\r\n", &result), DSL_PARSE_EMPTY);
+    CHECK_INT(Check_dsl_parse(";", &result), DSL_PARSE_EMPTY);
+}
+
+static void
+Check_dsl_results(void)
+{
+    struct DSL_result_T result, data;
+    char line[2 * DCC_MAX_PACKET_SIZE + 16];
+    int i;
+
+    /* A loco command and the same packet given as data agree. */
+    CHECK_INT(Check_dsl_parse("forward addr 3 speed 6\n", &result), DSL_PARSE_OK);
+    CHECK_INT(Check_dsl_parse("rawdata 0x0374\n", &data), DSL_PARSE_OK);
+    CHECK_INT(DCC_get_address(result.payload.packet), 3);
+    CHECK_INT(DCC_get_speed_step(result.payload.packet), 6);
+    CHECK_INT(DCC_get_direction(result.payload.packet), DCC_DIRECTION_FORWARD);
+    CHECK(memcmp(result.payload.packet->bytes, data.payload.packet->bytes,
+        result.payload.packet->size) == 0);
+    CHECK_INT(result.seq, DSL_SEQ_NONE);
+    Check_dsl_release(&result);
+    Check_dsl_release(&data);
+
+    CHECK_INT(Check_dsl_parse("reverse speed 12 addr 44\n", &result), DSL_PARSE_OK);
+    CHECK_INT(DCC_get_address(result.payload.packet), 44);
+    CHECK_INT(DCC_get_speed_step(result.payload.packet), 12);
+    CHECK_INT(DCC_get_direction(result.payload.packet), DCC_DIRECTION_REVERSE);
+    Check_dsl_release(&result);
+
+    CHECK_INT(Check_dsl_parse("stop all\n", &result), DSL_PARSE_OK);
+    CHECK(DCC_is_broadcast_stop(result.payload.packet));
+    Check_dsl_release(&result);
+
+    CHECK_INT(Check_dsl_parse("stop addr 9\n", &result), DSL_PARSE_OK);
+    CHECK(!DCC_is_broadcast_stop(result.payload.packet));
+    CHECK_INT(DCC_get_address(result.payload.packet), 9);
+    CHECK_INT(DCC_get_speed_step(result.payload.packet), 0);
+    Check_dsl_release(&result);
+
+    /* Raw bytes are copied as given. */
+    CHECK_INT(Check_dsl_parse("raw 0xDeadBeef\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.payload.packet->size, 4);
+    CHECK_INT(result.payload.packet->bytes[0], 0xde);
+    CHECK_INT(result.payload.packet->bytes[3], 0xef);
+    Check_dsl_release(&result);
+
+    /* System commands and their arguments. */
+    CHECK_INT(Check_dsl_parse("cache show 42\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.payload.cmd.type, SYS_CMD_TYPE_CACHE_SHOW);
+    CHECK_INT(result.payload.cmd.arg, 42);
+    CHECK_INT(Check_dsl_parse("mode machine\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.payload.cmd.type, SYS_CMD_TYPE_MODE);
+    CHECK_INT(result.payload.cmd.arg, IO_MODE_MACHINE);
+    CHECK_INT(Check_dsl_parse("show locos\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.payload.cmd.type, SYS_CMD_TYPE_LOCOS);
+
+    /* Tags reach the result and the packet, even for rejected lines. */
+    CHECK_INT(Check_dsl_parse("#123 forward addr 1 speed 1\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.seq, 123);
+    CHECK_INT(result.payload.packet->seq, 123);
+    Check_dsl_release(&result);
+    CHECK_INT(Check_dsl_parse("#7 forward addr 1\n", &result), DSL_PARSE_ERROR);
+    CHECK_INT(result.seq, 7);
+
+    /* The longest hex string, and one nibble pair more. */
+    strcpy(line, "raw 0x");
+    for(i=0; i < DCC_MAX_PACKET_SIZE; i++)
+        strcat(line, "a5");
+    strcat(line, "\n");
+    CHECK_INT(Check_dsl_parse(line, &result), DSL_PARSE_OK);
+    CHECK_INT(result.payload.packet->size, DCC_MAX_PACKET_SIZE);
+    Check_dsl_release(&result);
+    strcpy(line + strlen(line) - 1, "a5\n");
+    CHECK_INT(Check_dsl_parse(line, &result), DSL_PARSE_ERROR);
+
+    /* Data too long to frame. */
+    strcpy(line, "rawdata 0x");
+    for(i=0; i < DCC_MAX_PACKET_SIZE - 1; i++)
+        strcat(line, "01");
+    strcat(line, "\n");
+    CHECK_INT(Check_dsl_parse(line, &result), DSL_PARSE_ERROR);
+    CHECK_INT(Check_dsl_parse(line, NULL), DSL_PARSE_ERROR);
+
+    /* Numbers too large for an int saturate rather than wrap. */
+    CHECK_INT(Check_dsl_parse("#99999999999 help\n", &result), DSL_PARSE_OK);
+    CHECK_INT(result.seq, INT_MAX);
+
+    /* A keyword longer than any other is cut off without overrunning. */
+    CHECK_INT(Check_dsl_parse("showstatusshowstatusshowstatusshowstatus\n", &result),
+        DSL_PARSE_ERROR);
+
+    /* A reset discards the partial line. */
+    Check_dsl_parse("forward ad", &result);
+    DSL_parser_reset();
+    CHECK_INT(Check_dsl_parse("help\n", &result), DSL_PARSE_OK);
+}
+
+extern void
+Check_dsl(void)
+{
+    int nfree = DCC_pool_report_free();
+
+    DSL_module_init();
+    Check_dsl_grammar();
+    Check_dsl_results();
+
+    /* No packet is lost on any path. */
+    CHECK_INT(DCC_pool_report_free(), nfree);
+}
@@ -0,0 +1,107 @@
+/**
+ * @file check_hash.c
+ * @brief Tests the hash table module.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include "check.h"
+#include "hash.h"
+
+#define CHECK_HASH_SIZE 5
+
+static int Check_hash_destroyed;
+
+static int
+Check_hash_lookup(union Hash_key *key)
+{
+    return key->i;
+}
+
+static int
+Check_hash_cmp(union Hash_key *a, union Hash_key *b)
+{
+    return (a->i == b->i ? 0 : 1);
+}
+
+static void
+Check_hash_destroy(struct Hash_entry *entry)
+{
+    if(entry->v != NULL)
+        Check_hash_destroyed++;
+}
+
+static void *
+Check_hash_get(Hash_T hash, int i)
+{
+    union Hash_key key;
+
+    key.i = i;
+
+    return Hash_get(hash, &key);
+}
+
+static void
+Check_hash_insert(Hash_T hash, int i, void *value)
+{
+    union Hash_key key;
+
+    key.i = i;
+    Hash_insert(hash, key, value);
+}
+
+extern void
+Check_hash(void)
+{
+    char *values[] = { "a", "b", "c", "d", "e", "f" };
+    Hash_T hash;
+
+    hash = Hash_create(CHECK_HASH_SIZE, Check_hash_lookup, Check_hash_cmp,
+        Check_hash_destroy);
+    CHECK(hash != NULL);
+    CHECK(Check_hash_get(hash, 1) == NULL);
+
+    /* Keys 1, 6 and 11 share a slot, and probe to the following ones. */
+    Check_hash_insert(hash, 1, values[0]);
+    Check_hash_insert(hash, 6, values[1]);
+    Check_hash_insert(hash, 11, values[2]);
+    CHECK(hash->entries[1].v == values[0]);
+    CHECK(hash->entries[2].v == values[1]);
+    CHECK(hash->entries[3].v == values[2]);
+    CHECK(Check_hash_get(hash, 1) == values[0]);
+    CHECK(Check_hash_get(hash, 6) == values[1]);
+    CHECK(Check_hash_get(hash, 11) == values[2]);
+    CHECK(Check_hash_get(hash, 16) == NULL);
+
+    /* Probing wraps from the last slot round to the first. */
+    Check_hash_insert(hash, 4, values[3]);
+    Check_hash_insert(hash, 9, values[4]);
+    CHECK(hash->entries[4].v == values[3]);
+    CHECK(hash->entries[0].v == values[4]);
+    CHECK(Check_hash_get(hash, 9) == values[4]);
+    CHECK(Check_hash_get(hash, 4) == values[3]);
+
+    /* Overwriting destroys the old value in place. */
+    Check_hash_destroyed = 0;
+    Check_hash_insert(hash, 6, values[5]);
+    CHECK_INT(Check_hash_destroyed, 1);
+    CHECK(hash->entries[2].v == values[5]);
+    CHECK(Check_hash_get(hash, 6) == values[5]);
+    CHECK(Check_hash_get(hash, 11) == values[2]);
+
+    /* A reset destroys every value. */
+    Check_hash_destroyed = 0;
+    Hash_reset(hash);
+    CHECK_INT(Check_hash_destroyed, CHECK_HASH_SIZE);
+    CHECK(Check_hash_get(hash, 1) == NULL);
+    CHECK(Check_hash_get(hash, 9) == NULL);
+
+    /* Keys larger than the table. */
+    Check_hash_insert(hash, 1000, values[0]);
+    CHECK(Check_hash_get(hash, 1000) == values[0]);
+    CHECK(Check_hash_get(hash, 5) == NULL);
+
+    Check_hash_destroyed = 0;
+    Hash_destroy(hash);
+    CHECK_INT(Check_hash_destroyed, 1);
+}
@@ -0,0 +1,175 @@
+/**
+ * @file check_io.c
+ * @brief Tests the serial line framing.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Characters are passed to the receive interrupt handler as the USART
+ * would, and the replies captured from stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "hal.h"
+#include "io.h"
+#include "scheduler.h"
+
+/**
+ * Receive a string, with a USART error in place of each '~'.
+ */
+static void
+Check_io_receive(const char *s)
+{
+    for(; *s != '\0'; s++)
+    {
+        Hal_usart_rx_status = (*s == '~');
+        Hal_usart_rx_data = *s;
+        HAL_VECT_USART_RX();
+    }
+}
+
+/**
+ * Read the received commands, returning the replies and the sequence
+ * numbers of the packets given, which are destroyed.
+ */
+static char *
+Check_io_read(int *seqs, int max, int *n)
+{
+    FILE *out = stdout;
+    DCC_packet_T packet;
+    size_t len;
+    char *replies;
+
+    stdout = open_memstream(&replies, &len);
+
+    for(*n = 0; (packet = IO_read()) != NULL; )
+    {
+        if(*n < max)
+            seqs[(*n)++] = packet->seq;
+        DCC_packet_destroy(packet);
+    }
+
+    fclose(stdout);
+    stdout = out;
+
+    return replies;
+}
+
+/**
+ * Append the CRC-8 a host would send to a line, with the given bits
+ * flipped.
+ */
+static void
+Check_io_crc(char *line, size_t max, uint8_t flip)
+{
+    uint8_t crc = 0;
+    const char *p;
+    int i;
+
+    for(p = line; *p != '\0'; p++)
+    {
+        crc ^= *p;
+        for(i=0; i < 8; i++)
+            crc = ((crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1));
+    }
+
+    snprintf(line + strlen(line), max - strlen(line), "*%02X\n", crc ^ flip);
+}
+
+/**
+ * Read a serial link counter from the status line.
+ */
+static long
+Check_io_counter(const char *key)
+{
+    const char *found;
+    char *replies;
+    long value = -1;
+    int n;
+
+    Check_io_receive("show status\n");
+    replies = Check_io_read(NULL, 0, &n);
+    if((found = strstr(replies, key)) != NULL)
+        value = strtol(found + strlen(key), NULL, 10);
+    free(replies);
+
+    return value;
+}
+
+extern void
+Check_io(void)
+{
+    FILE *out = stdout;
+    char *replies, line[64];
+    long crc_errors, rx_errors;
+    int seqs[4], n;
+
+    /* The module takes stdout for the serial line. */
+    Scheduler_module_init();
+    IO_module_init();
+    stdout = out;
+    IO_set_mode(IO_MODE_MACHINE);
+
+    /* Good commands, ended either way. */
+    Check_io_receive("#1 forward addr 3 speed 5;#2 stop addr 4\n");
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 2);
+    CHECK_INT(seqs[0], 1);
+    CHECK_INT(seqs[1], 2);
+    CHECK(strcmp(replies, "") == 0);
+    free(replies);
+
+    /* An error voids only the command it fell in, up to the semicolon. */
+    Check_io_receive("#3 forward addr 3 spe~ed 5;#4 stop addr 4;");
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 1);
+    CHECK_INT(seqs[0], 4);
+    CHECK(strcmp(replies, "err 3\n") == 0);
+    free(replies);
+
+    /* And up to the end of the line. */
+    Check_io_receive("#5 stop~ addr 4\n#6 stop addr 5\n");
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 1);
+    CHECK_INT(seqs[0], 6);
+    CHECK(strcmp(replies, "err 5\n") == 0);
+    free(replies);
+
+    /* With CRC checking a semicolon is not allowed at all. */
+    IO_set_crc(1);
+    Check_io_receive("#7 stop addr 4;#8 stop addr 5*00\n");
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 0);
+    CHECK(strcmp(replies, "nak 7\n") == 0);
+    free(replies);
+    IO_set_crc(0);
+
+    /* Lost input is counted once, as a receive error and not a CRC error. */
+    crc_errors = Check_io_counter(" link_crc_errors=");
+    rx_errors = Check_io_counter(" link_rx_errors=");
+    IO_set_crc(1);
+    strcpy(line, "#9 stop addr 4");
+    Check_io_crc(line, sizeof(line), 0);
+    Check_io_receive(line);
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 1);
+    CHECK_INT(seqs[0], 9);
+    free(replies);
+    line[5] = '~';
+    Check_io_receive(line);
+    strcpy(line, "#10 stop addr 4");
+    Check_io_crc(line, sizeof(line), 0x01);
+    Check_io_receive(line);
+    replies = Check_io_read(seqs, 4, &n);
+    CHECK_INT(n, 0);
+    CHECK(strcmp(replies, "nak 9\nnak 10\n") == 0);
+    free(replies);
+    IO_set_crc(0);
+    CHECK_INT(Check_io_counter(" link_crc_errors="), crc_errors + 1);
+    CHECK_INT(Check_io_counter(" link_rx_errors="), rx_errors + 1);
+
+    IO_set_mode(IO_MODE_HUMAN);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file check_ring.c
+ * @brief Tests the ring buffer module.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include "check.h"
+#include "ring.h"
+
+static void
+Check_ring_push_int(Ring_T ring, int i)
+{
+    union Ring_data data;
+
+    data.i = i;
+    Ring_push(ring, data);
+}
+
+extern void
+Check_ring(void)
+{
+    union Ring_data data;
+    Ring_T ring;
+    int i;
+
+    ring = Ring_create(RING_TYPE_INT, 3);
+    CHECK(ring != NULL);
+    CHECK_INT(ring->type, RING_TYPE_INT);
+    CHECK_INT(ring->size, 3);
+    CHECK_INT(ring->count, 0);
+
+    /* First in, first out. */
+    Check_ring_push_int(ring, 1);
+    Check_ring_push_int(ring, 2);
+    CHECK_INT(ring->count, 2);
+    CHECK_INT(Ring_pop(ring).i, 1);
+    CHECK_INT(Ring_pop(ring).i, 2);
+    CHECK_INT(ring->count, 0);
+
+    /* Filling the ring with the start part way round wraps the end. */
+    for(i=3; i <= 5; i++)
+        Check_ring_push_int(ring, i);
+    CHECK_INT(ring->count, 3);
+    CHECK_INT(ring->start, 2);
+    for(i=3; i <= 5; i++)
+        CHECK_INT(Ring_pop(ring).i, i);
+    CHECK_INT(ring->start, 2);
+
+    /* Many times round. */
+    for(i=0; i < 100; i++)
+    {
+        Check_ring_push_int(ring, i);
+        Check_ring_push_int(ring, -i);
+        CHECK_INT(Ring_pop(ring).i, i);
+        CHECK_INT(Ring_pop(ring).i, -i);
+    }
+    CHECK_INT(ring->count, 0);
+
+    /* A reset ring is empty and starts again from the front. */
+    Check_ring_push_int(ring, 7);
+    Ring_reset(ring);
+    CHECK_INT(ring->count, 0);
+    CHECK_INT(ring->start, 0);
+    Check_ring_push_int(ring, 8);
+    CHECK_INT(Ring_pop(ring).i, 8);
+    Ring_destroy(ring);
+
+    /* A ring of one. */
+    ring = Ring_create(RING_TYPE_CHAR, 1);
+    for(i=0; i < 4; i++)
+    {
+        data.c = 'a' + i;
+        Ring_push(ring, data);
+        CHECK_INT(ring->count, 1);
+        CHECK_INT(Ring_pop(ring).c, 'a' + i);
+        CHECK_INT(ring->start, 0);
+    }
+    Ring_destroy(ring);
+
+    /* Packets are held by reference. */
+    ring = Ring_create(RING_TYPE_PACKET, 2);
+    data.p = DCC_baseline_packet_create();
+    Ring_push(ring, data);
+    CHECK(Ring_pop(ring).p == data.p);
+    DCC_packet_destroy(data.p);
+    Ring_destroy(ring);
+}
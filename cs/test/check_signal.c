@@ -0,0 +1,124 @@
+/**
+ * @file check_signal.c
+ * @brief Tests the signal module against the scheduler's flush period.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The timer of the native backend is replaced (see the Makefile), so each
+ * compare value loaded is taken as one bit on the track, lasting two
+ * periods, and the interrupt handlers are called as the cycles pass.
+ */
+
+#include <stdint.h>
+
+#include "check.h"
+#include "hal.h"
+#include "signal.h"
+#include "scheduler.h"
+#include "cache.h"
+
+#define CHECK_SIGNAL_HALF_1       852
+#define CHECK_SIGNAL_FLUSH_CYCLES 128000UL  /**< (124 + 1) x 1024. */
+#define CHECK_SIGNAL_MAX_BITS     2048
+
+static uint8_t Check_signal_bits[CHECK_SIGNAL_MAX_BITS];
+static int Check_signal_nbits;
+static uint16_t Check_signal_period;
+
+extern void __wrap_Hal_signal_set_period(uint16_t cycles);
+extern uint8_t __wrap_Hal_signal_is_high(void);
+
+extern void
+__wrap_Hal_signal_set_period(uint16_t cycles)
+{
+    Check_signal_period = cycles;
+
+    if(Check_signal_nbits < CHECK_SIGNAL_MAX_BITS)
+        Check_signal_bits[Check_signal_nbits++] = (cycles == CHECK_SIGNAL_HALF_1);
+}
+
+extern uint8_t
+__wrap_Hal_signal_is_high(void)
+{
+    /* Each call of the handler ends a whole bit. */
+    return 1;
+}
+
+/**
+ * Run the track for the given number of flush periods.
+ */
+static void
+Check_signal_run(int periods)
+{
+    uint64_t now = 0, flush = CHECK_SIGNAL_FLUSH_CYCLES,
+        end = periods * CHECK_SIGNAL_FLUSH_CYCLES;
+
+    while(now < end)
+    {
+        now += 2 * ((uint64_t) Check_signal_period + 1);
+
+        if(now >= flush)
+        {
+            HAL_VECT_SCHEDULER();
+            flush += CHECK_SIGNAL_FLUSH_CYCLES;
+        }
+
+        HAL_VECT_SIGNAL();
+    }
+}
+
+/**
+ * Find the bits of a packet, whole and in order, in those sent.
+ */
+static int
+Check_signal_sent(DCC_packet_T packet)
+{
+    int bits = packet->size * 8, i, j;
+
+    for(i=0; i + bits <= Check_signal_nbits; i++)
+    {
+        for(j=0; j < bits; j++)
+        {
+            if(Check_signal_bits[i + j] != ((packet->bytes[j / 8] >> (7 - (j % 8))) & 1))
+                break;
+        }
+
+        if(j == bits)
+            return 1;
+    }
+
+    return 0;
+}
+
+extern void
+Check_signal(void)
+{
+    /* The longest data all zeros, which is also its checksum. */
+    unsigned char zeros[10] = { 0 };
+    DCC_packet_T packet, idle;
+
+    Scheduler_module_init();
+    CHECK(!Signal_busy());
+
+    /* Framed, this is the longest packet and takes over two flush periods. */
+    packet = DCC_framed_packet_create(zeros, sizeof(zeros));
+    CHECK(packet != NULL);
+    CHECK_INT(packet->size, DCC_FRAMED_SIZE(sizeof(zeros)));
+    CHECK(DCC_framed_packet_create(zeros, sizeof(zeros) + 1) == NULL);
+
+    /* Queue it behind the idle packets already running. */
+    Check_signal_nbits = 0;
+    Check_signal_run(2);
+    CHECK(Scheduler_add_packet(packet));
+    Check_signal_run(8);
+
+    CHECK(Check_signal_sent(packet));
+
+    /* The idle packets either side of it still go out every period. */
+    idle = DCC_baseline_packet_create();
+    DCC_special_idle_packet(idle);
+    CHECK(Check_signal_sent(idle));
+    DCC_packet_destroy(idle);
+
+    Cache_clear();
+}
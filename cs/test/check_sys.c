@@ -0,0 +1,245 @@
+/**
+ * @file check_sys.c
+ * @brief Tests the system commands.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The output function of the native backend is replaced (see the
+ * Makefile), so the output can be captured and the scheduler's work done
+ * while it is printed, as on the target.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "cache.h"
+#include "io.h"
+#include "sys.h"
+#include "trace.h"
+#include "scheduler.h"
+
+static char *Check_sys_out;
+static size_t Check_sys_len;
+static FILE *Check_sys_stream;
+static void (*Check_sys_isr)(void);
+static int Check_sys_chars;
+static DCC_packet_T Check_sys_idle;
+
+static DCC_packet_T Check_sys_loco(int address, int step);
+
+/**
+ * The reports, with the key each line starts with in machine mode.
+ */
+static const struct
+{
+    uint8_t type;
+    const char *key;
+} Check_sys_reports[] = {
+    { SYS_CMD_TYPE_TIMING,    "timing " },
+    { SYS_CMD_TYPE_BANDWIDTH, "bandwidth " },
+    { SYS_CMD_TYPE_LATENCY,   "latency " },
+    { SYS_CMD_TYPE_TRACE_SHOW, "trace " }
+};
+
+#define CHECK_SYS_NUM_REPORTS (sizeof(Check_sys_reports) / sizeof(Check_sys_reports[0]))
+
+extern int __wrap_Hal_printf_P(const char *fmt, ...);
+
+/**
+ * Capture the output, with the flash string conversion rewritten as for
+ * the native backend.
+ */
+extern int
+__wrap_Hal_printf_P(const char *fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    size_t i;
+    int n;
+
+    for(i=0; *fmt != '\0' && i < (sizeof(buf) - 1); fmt++, i++)
+        buf[i] = (fmt[0] == 'S' && i > 0 && buf[i - 1] == '%' ? 's' : fmt[0]);
+    buf[i] = '\0';
+
+    va_start(ap, fmt);
+    n = vfprintf(Check_sys_stream != NULL ? Check_sys_stream : stdout, buf, ap);
+    va_end(ap);
+
+    /* At 9600 baud, the scheduler sends a packet every 8 characters. */
+    for(Check_sys_chars += n; Check_sys_isr != NULL && Check_sys_chars >= 8; Check_sys_chars -= 8)
+        Check_sys_isr();
+
+    return n;
+}
+
+static void
+Check_sys_refresh(void)
+{
+    Cache_get_next_packet();
+}
+
+static void
+Check_sys_replace(void)
+{
+    Cache_update(Check_sys_loco(5, 6));
+}
+
+static void
+Check_sys_trace_idle(void)
+{
+    Trace_record(SCHEDULER_CAT_IDLE, Check_sys_idle);
+}
+
+/**
+ * Count the lines of output containing a string.
+ */
+static int
+Check_sys_lines(const char *out, const char *match)
+{
+    const char *line, *end;
+    int n = 0;
+
+    for(line = out; (end = strchr(line, '\n')) != NULL; line = end + 1)
+    {
+        const char *found = strstr(line, match);
+
+        n += (found != NULL && found < end);
+    }
+
+    return n;
+}
+
+/**
+ * Count the occurrences of a string in the output.
+ */
+static int
+Check_sys_count(const char *out, const char *match)
+{
+    int n = 0;
+
+    for(; (out = strstr(out, match)) != NULL; out++)
+        n++;
+
+    return n;
+}
+
+static DCC_packet_T
+Check_sys_loco(int address, int step)
+{
+    DCC_packet_T packet = DCC_baseline_packet_create();
+
+    DCC_set_preamble(packet);
+    DCC_set_address(packet, address);
+    DCC_set_speed_direction_preamble(packet);
+    DCC_set_direction(packet, DCC_DIRECTION_FORWARD);
+    DCC_set_speed(packet, step);
+    DCC_set_checksum(packet);
+    DCC_set_packet_end(packet);
+
+    return packet;
+}
+
+/**
+ * Run a system command, returning its output.
+ */
+static const char *
+Check_sys_run_arg(uint8_t type, int arg)
+{
+    struct Sys_cmd_T cmd;
+
+    Check_sys_stream = open_memstream(&Check_sys_out, &Check_sys_len);
+    Sys_cmd_init(&cmd, type, arg);
+    cmd.call(cmd.arg);
+    fclose(Check_sys_stream);
+    Check_sys_stream = NULL;
+
+    return Check_sys_out;
+}
+
+static const char *
+Check_sys_run(uint8_t type)
+{
+    return Check_sys_run_arg(type, 0);
+}
+
+extern void
+Check_sys(void)
+{
+    char expect[32];
+    DCC_packet_T packet;
+    const char *out;
+    int i;
+
+    Cache_module_init();
+    IO_set_mode(IO_MODE_MACHINE);
+
+    /* Several locos, refreshed as the list is printed. */
+    for(i=1; i <= 7; i++)
+        Cache_update(Check_sys_loco(i, i));
+
+    Check_sys_isr = Check_sys_refresh;
+    out = Check_sys_run(SYS_CMD_TYPE_LOCOS);
+    Check_sys_isr = NULL;
+
+    for(i=1; i <= 7; i++)
+    {
+        snprintf(expect, sizeof(expect), "loco addr=%d cached=1 speed=%d ", i, i);
+        CHECK_INT(Check_sys_lines(out, expect), 1);
+    }
+    CHECK_INT(Check_sys_lines(out, ""), 7);
+
+    free(Check_sys_out);
+
+    /* A single loco, replaced by the scheduler as it is printed. */
+    Check_sys_isr = Check_sys_replace;
+    out = Check_sys_run_arg(SYS_CMD_TYPE_CACHE_SHOW, 5);
+    Check_sys_isr = NULL;
+    CHECK(strncmp(out, "loco addr=5 cached=1 speed=5 dir=1 hex=", 39) == 0);
+    CHECK(strstr(out, "speed=6") == NULL);
+    free(Check_sys_out);
+    Cache_clear();
+
+    /* The reports are one line each. */
+    for(i=0; i < CHECK_SYS_NUM_REPORTS; i++)
+    {
+        out = Check_sys_run(Check_sys_reports[i].type);
+        CHECK(strncmp(out, Check_sys_reports[i].key, strlen(Check_sys_reports[i].key)) == 0);
+        CHECK_INT(Check_sys_lines(out, ""), 1);
+        CHECK(strchr(out, '\t') == NULL);
+        free(Check_sys_out);
+    }
+
+    /* A full trace, dumped whole while idle packets go out. */
+    Check_sys_idle = DCC_baseline_packet_create();
+    DCC_special_idle_packet(Check_sys_idle);
+    Trace_module_init();
+    for(i=1; i <= TRACE_LEN + 3; i++)
+    {
+        packet = Check_sys_loco(i, 1);
+        Trace_record(SCHEDULER_CAT_NEW, packet);
+        DCC_packet_destroy(packet);
+    }
+
+    Check_sys_isr = Check_sys_trace_idle;
+    out = Check_sys_run(SYS_CMD_TYPE_TRACE_SHOW);
+    Check_sys_isr = NULL;
+
+    CHECK_INT(Check_sys_lines(out, ""), 1);
+    CHECK_INT(Check_sys_count(out, ":new:"), TRACE_LEN);
+    CHECK_INT(Check_sys_count(out, ":idle:"), 0);
+    free(Check_sys_out);
+
+    /* Recording resumes once the dump is done. */
+    Trace_record(SCHEDULER_CAT_IDLE, Check_sys_idle);
+    out = Check_sys_run(SYS_CMD_TYPE_TRACE_SHOW);
+    CHECK_INT(Check_sys_count(out, ":new:"), TRACE_LEN - 1);
+    CHECK_INT(Check_sys_count(out, ":idle:"), 1);
+    free(Check_sys_out);
+
+    DCC_packet_destroy(Check_sys_idle);
+    Trace_module_init();
+    IO_set_mode(IO_MODE_HUMAN);
+}
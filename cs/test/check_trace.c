@@ -0,0 +1,64 @@
+/**
+ * @file check_trace.c
+ * @brief Tests the transmitted packet trace buffer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "trace.h"
+#include "scheduler.h"
+
+/**
+ * Record a number of packets and dump the trace, returning how many
+ * packets it shows.
+ */
+static int
+Check_trace_dumped(long packets, DCC_packet_T packet)
+{
+    FILE *out = stdout;
+    const char *found;
+    char *dump;
+    size_t len;
+    int n = 0;
+
+    for(; packets > 0; packets--)
+        Trace_record(SCHEDULER_CAT_NEW, packet);
+
+    stdout = open_memstream(&dump, &len);
+    Trace_dump(1);
+    fclose(stdout);
+    stdout = out;
+
+    for(found = dump; (found = strstr(found, ":new:")) != NULL; found++)
+        n++;
+    free(dump);
+
+    return n;
+}
+
+extern void
+Check_trace(void)
+{
+    DCC_packet_T packet = DCC_baseline_packet_create();
+
+    DCC_special_idle_packet(packet);
+
+    /* Entries not yet written are not shown. */
+    Trace_module_init();
+    CHECK_INT(Check_trace_dumped(0, packet), 0);
+    CHECK_INT(Check_trace_dumped(3, packet), 3);
+
+    /* Nor is the buffer shorter once the count has wrapped. */
+    CHECK_INT(Check_trace_dumped(65536L - 3 - 2, packet), TRACE_LEN);
+    CHECK_INT(Check_trace_dumped(1, packet), TRACE_LEN);
+    CHECK_INT(Check_trace_dumped(1, packet), TRACE_LEN);
+    CHECK_INT(Check_trace_dumped(1, packet), TRACE_LEN);
+
+    DCC_packet_destroy(packet);
+    Trace_module_init();
+}
@@ -0,0 +1,61 @@
+/**
+ * @file check_utils.c
+ * @brief Tests the general utilities.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "utils.h"
+
+/**
+ * Percentages, with the text each prints as. Large values lose their low
+ * bits, and the result is truncated rather than rounded.
+ */
+static const struct
+{
+    uint32_t part;
+    uint32_t whole;
+    const char *text;
+} Check_utils_percents[] = {
+    { 0,            0,            "0.00%" },
+    { 5,            0,            "0.00%" },
+    { 0,            7,            "0.00%" },
+    { 1,            2,            "50.00%" },
+    { 1,            3,            "33.33%" },
+    { 9999,         10000,        "99.99%" },
+    { 7,            7,            "100.00%" },
+    { 429496,       429496,       "100.00%" },
+    { 429497,       429497,       "100.00%" },
+    { 3000000000UL, 4000000000UL, "74.99%" },
+    { UINT32_MAX,   UINT32_MAX,   "100.00%" },
+    { 1,            UINT32_MAX,   "0.00%" },
+    { 500000,       5000,         "10000.00%" }
+};
+
+#define CHECK_UTILS_NUM_PERCENTS \
+    (sizeof(Check_utils_percents) / sizeof(Check_utils_percents[0]))
+
+extern void
+Check_utils(void)
+{
+    FILE *out = stdout;
+    char *text;
+    size_t len;
+    int i;
+
+    for(i=0; i < CHECK_UTILS_NUM_PERCENTS; i++)
+    {
+        stdout = open_memstream(&text, &len);
+        print_percent(Check_utils_percents[i].part, Check_utils_percents[i].whole);
+        fclose(stdout);
+        stdout = out;
+
+        CHECK(strcmp(text, Check_utils_percents[i].text) == 0);
+        free(text);
+    }
+}
@@ -0,0 +1,408 @@
+/**
+ * @file dsl_fuzz.c
+ * @brief Fuzzing harness and throughput benchmark for the DSL parser.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Feeds arbitrary bytes to DSL_parser_feed() and checks, after every
+ * byte, that:
+ *
+ * - a parsed line has a known result type, and any packet in it is one
+ *   the signal module could send,
+ * - a rejected or blank line leaves no result,
+ * - a syntax check (a NULL result) gives the same status as a parse,
+ * - no packet is lost from the pool.
+ *
+ * A broken check aborts, which every fuzzer reports as a crash. The
+ * harness builds three ways:
+ *
+ * - with libFuzzer (-DDSL_FUZZ_LIBFUZZER), which calls
+ *   LLVMFuzzerTestOneInput() directly,
+ * - standalone, where each file named is run once, or stdin if there are
+ *   none, as AFL expects with @@ or a pipe,
+ * - standalone with -m n, which runs n inputs mutated from the files
+ *   given, so the parser can be fuzzed where neither tool is installed.
+ *
+ * With -b n the files are instead parsed n times over and the throughput
+ * reported in lines, bytes and tokens per second.
+ *
+ * The standalone build is compiled with the address and undefined
+ * behaviour sanitizers, see make fuzz.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dsl.h"
+
+#define FUZZ_MAX_INPUT  1024
+#define FUZZ_MAX_FILES  256
+
+static int Fuzz_pool_free = -1;
+
+/* The input being run, written out if a check fails. */
+static const uint8_t *Fuzz_data;
+static size_t Fuzz_size;
+
+static void Fuzz_check(int cond, const char *what);
+static void Fuzz_check_result(int status, struct DSL_result_T *result);
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+extern int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    struct DSL_result_T result;
+    int *status, i;
+
+    if(Fuzz_pool_free < 0)
+    {
+        DSL_module_init();
+        Fuzz_pool_free = DCC_pool_report_free();
+    }
+
+    if((status = malloc((size + 1) * sizeof(*status))) == NULL)
+        return 0;
+
+    Fuzz_data = data;
+    Fuzz_size = size;
+
+    /* Parse, ending with a newline in case the input does not. */
+    for(i=0; i <= size; i++)
+    {
+        status[i] = DSL_parser_feed(i < size ? data[i] : '\n', &result);
+        Fuzz_check_result(status[i], &result);
+    }
+
+    /* A syntax check of the same input must agree on every line. */
+    for(i=0; i <= size; i++)
+    {
+        Fuzz_check(DSL_parser_feed(i < size ? data[i] : '\n', NULL) == status[i],
+            "syntax check and parse disagree");
+    }
+
+    free(status);
+
+    Fuzz_check(DCC_pool_report_free() == Fuzz_pool_free, "packet lost from the pool");
+
+    return 0;
+}
+
+static void
+Fuzz_check_result(int status, struct DSL_result_T *result)
+{
+    DCC_packet_T packet;
+
+    switch(status)
+    {
+        case DSL_PARSE_PENDING:
+            return;
+
+        case DSL_PARSE_ERROR:
+        case DSL_PARSE_EMPTY:
+            Fuzz_check(result->type == DSL_RES_TYPE_UNDEF, "result left by a rejected line");
+            return;
+
+        case DSL_PARSE_OK:
+            break;
+
+        default:
+            Fuzz_check(0, "unknown parse status");
+    }
+
+    switch(result->type)
+    {
+        case DSL_RES_TYPE_SYS:
+            return;
+
+        case DSL_RES_TYPE_DCC:
+        case DSL_RES_TYPE_RAW:
+        case DSL_RES_TYPE_DATA:
+            packet = result->payload.packet;
+            Fuzz_check(packet != NULL, "parsed line without a packet");
+            Fuzz_check(packet->size > 0 && packet->size <= DCC_MAX_PACKET_SIZE,
+                "packet size out of range");
+            Fuzz_check(packet->seq == result->seq, "packet tag differs from the line");
+            DCC_packet_destroy(packet);
+            return;
+
+        default:
+            Fuzz_check(0, "unknown result type");
+    }
+}
+
+static void
+Fuzz_check(int cond, const char *what)
+{
+    FILE *out;
+
+    if(!cond)
+    {
+        fprintf(stderr, "dsl_fuzz: %s\n", what);
+#ifndef DSL_FUZZ_LIBFUZZER
+        /* libFuzzer saves the input itself. */
+        if((out = fopen("dsl_fuzz.crash", "wb")) != NULL)
+        {
+            fwrite(Fuzz_data, 1, Fuzz_size, out);
+            fclose(out);
+            fprintf(stderr, "dsl_fuzz: input written to dsl_fuzz.crash\n");
+        }
+#endif
+        abort();
+    }
+}
+
+#ifndef DSL_FUZZ_LIBFUZZER
+
+/**
+ * Inputs read from the files named.
+ */
+static struct
+{
+    uint8_t data[FUZZ_MAX_INPUT];
+    size_t size;
+} Fuzz_inputs[FUZZ_MAX_FILES];
+static int Fuzz_num_inputs;
+
+/**
+ * Keywords and fragments spliced in by the mutator.
+ */
+static const char *Fuzz_dict[] = {
+    "forward", "reverse", "stop", "addr", "speed", "all", "show", "status",
+    "help", "raw", "rawdata", "cache", "clear", "mode", "machine", "human",
+    "crc", "on", "off", "timing", "bandwidth", "latency", "trace", "locos",
+    "0x", "0X", "#", ";", "\n", " ", "\t", "\r", "0", "127", "128", "99999999999",
+    "ffffffffffffffffffffffffffffffff"
+};
+
+#define FUZZ_DICT_SIZE (sizeof(Fuzz_dict) / sizeof(Fuzz_dict[0]))
+
+static uint32_t Fuzz_rand_state = 1;
+
+static uint32_t Fuzz_rand(void);
+static void Fuzz_read(FILE *in, const char *name);
+static size_t Fuzz_mutate(uint8_t *data, size_t size);
+static double Fuzz_now(void);
+static void Fuzz_usage(void);
+
+int
+main(int argc, char **argv)
+{
+    uint8_t data[FUZZ_MAX_INPUT];
+    unsigned long mutations = 0, bench = 0, n;
+    uint64_t bytes = 0, lines = 0, tokens = 0;
+    double start, secs;
+    size_t size;
+    FILE *in;
+    int c, i, j;
+
+    while((c = getopt(argc, argv, "m:b:s:")) != -1)
+    {
+        switch(c)
+        {
+            case 'm':
+                mutations = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'b':
+                bench = strtoul(optarg, NULL, 10);
+                break;
+
+            case 's':
+                Fuzz_rand_state = strtoul(optarg, NULL, 10) | 1;
+                break;
+
+            default:
+                Fuzz_usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    for(i = optind; i < argc; i++)
+    {
+        if((in = fopen(argv[i], "rb")) == NULL)
+        {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        Fuzz_read(in, argv[i]);
+        fclose(in);
+    }
+
+    if(optind == argc)
+        Fuzz_read(stdin, "stdin");
+
+    if(bench > 0)
+    {
+        /* Lines and whitespace separated words, as the scanner sees them. */
+        for(i=0; i < Fuzz_num_inputs; i++)
+        {
+            for(j=0, c=0; j < Fuzz_inputs[i].size; j++)
+            {
+                if(Fuzz_inputs[i].data[j] == '\n' || Fuzz_inputs[i].data[j] == ';')
+                    lines++;
+
+                if(strchr(" \t\r\n;", Fuzz_inputs[i].data[j]) != NULL)
+                    c = 0;
+                else if(!c && (c = 1))
+                    tokens++;
+            }
+            bytes += Fuzz_inputs[i].size;
+        }
+
+        start = Fuzz_now();
+        for(n=0; n < bench; n++)
+        {
+            for(i=0; i < Fuzz_num_inputs; i++)
+                LLVMFuzzerTestOneInput(Fuzz_inputs[i].data, Fuzz_inputs[i].size);
+        }
+        secs = Fuzz_now() - start;
+
+        /* Each input is parsed, then syntax checked. */
+        printf("corpus:\t\t%d inputs, %" PRIu64 " bytes, %" PRIu64 " lines\n",
+            Fuzz_num_inputs, bytes, lines);
+        printf("lines:\t\t%12.0f /s\n", 2.0 * bench * lines / secs);
+        printf("tokens:\t\t%12.0f /s\n", 2.0 * bench * tokens / secs);
+        printf("bytes:\t\t%12.0f /s\n", 2.0 * bench * bytes / secs);
+
+        return EXIT_SUCCESS;
+    }
+
+    for(i=0; i < Fuzz_num_inputs; i++)
+        LLVMFuzzerTestOneInput(Fuzz_inputs[i].data, Fuzz_inputs[i].size);
+
+    if(mutations > 0 && Fuzz_num_inputs > 0)
+    {
+        start = Fuzz_now();
+        for(n=0; n < mutations; n++)
+        {
+            i = Fuzz_rand() % Fuzz_num_inputs;
+            memcpy(data, Fuzz_inputs[i].data, Fuzz_inputs[i].size);
+            size = Fuzz_mutate(data, Fuzz_inputs[i].size);
+            LLVMFuzzerTestOneInput(data, size);
+        }
+        secs = Fuzz_now() - start;
+
+        printf("%lu mutated inputs, %.0f /s, no failures\n", mutations, mutations / secs);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void
+Fuzz_read(FILE *in, const char *name)
+{
+    if(Fuzz_num_inputs == FUZZ_MAX_FILES)
+    {
+        fprintf(stderr, "dsl_fuzz: too many inputs, ignoring %s\n", name);
+        return;
+    }
+
+    Fuzz_inputs[Fuzz_num_inputs].size = fread(Fuzz_inputs[Fuzz_num_inputs].data, 1,
+        FUZZ_MAX_INPUT, in);
+    Fuzz_num_inputs++;
+}
+
+/**
+ * Apply one to four random edits, keeping within FUZZ_MAX_INPUT.
+ */
+static size_t
+Fuzz_mutate(uint8_t *data, size_t size)
+{
+    const char *word;
+    size_t pos, len;
+    int edits = 1 + (Fuzz_rand() % 4);
+
+    while(edits-- > 0)
+    {
+        pos = (size > 0 ? Fuzz_rand() % (size + 1) : 0);
+
+        switch(Fuzz_rand() % 5)
+        {
+            case 0:
+                /* Flip a bit. */
+                if(pos < size)
+                    data[pos] ^= (1 << (Fuzz_rand() % 8));
+                break;
+
+            case 1:
+                /* Replace a byte. */
+                if(pos < size)
+                    data[pos] = Fuzz_rand();
+                break;
+
+            case 2:
+                /* Delete a run. */
+                len = 1 + (Fuzz_rand() % 8);
+                if(pos + len <= size)
+                {
+                    memmove(data + pos, data + pos + len, size - pos - len);
+                    size -= len;
+                }
+                break;
+
+            case 3:
+                /* Duplicate a run. */
+                len = 1 + (Fuzz_rand() % 16);
+                if(pos + len <= size && size + len <= FUZZ_MAX_INPUT)
+                {
+                    memmove(data + pos + len, data + pos, size - pos);
+                    size += len;
+                }
+                break;
+
+            case 4:
+                /* Splice in a keyword or fragment. */
+                word = Fuzz_dict[Fuzz_rand() % FUZZ_DICT_SIZE];
+                len = strlen(word);
+                if(size + len <= FUZZ_MAX_INPUT)
+                {
+                    memmove(data + pos + len, data + pos, size - pos);
+                    memcpy(data + pos, word, len);
+                    size += len;
+                }
+                break;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * Xorshift, so a seed repeats a run exactly.
+ */
+static uint32_t
+Fuzz_rand(void)
+{
+    Fuzz_rand_state ^= Fuzz_rand_state << 13;
+    Fuzz_rand_state ^= Fuzz_rand_state >> 17;
+    Fuzz_rand_state ^= Fuzz_rand_state << 5;
+
+    return Fuzz_rand_state;
+}
+
+static double
+Fuzz_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void
+Fuzz_usage(void)
+{
+    fprintf(stderr, "usage: dsl_fuzz [-m mutations] [-s seed] [-b rounds] [file ...]\n");
+    fprintf(stderr, "  -m n      run n inputs mutated from the files\n");
+    fprintf(stderr, "  -s seed   seed the mutator (default 1)\n");
+    fprintf(stderr, "  -b n      report parse throughput over n passes of the files\n");
+}
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file dsl_kw_bench.c
+ * @brief Host benchmark of the DSL keyword recogniser.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Measures keyword tokens recognised per second by the generated perfect
+ * hash in dsl_kw.h, against the strcmp chain it replaced. Each token in
+ * the vocabulary is also timed on its own to show that the hash lookup
+ * cost does not depend on where a keyword sits in the vocabulary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <avr/pgmspace.h>
+
+#include "dsl.h"
+#include "dsl_kw.h"
+
+#define BENCH_ROUNDS 2000000
+
+#define DSL_CMP(str, len, tok) ((len == strlen_P(PSTR(tok))) \
+                                && !strncmp_P(str, PSTR(tok), len))
+
+/**
+ * A representative token stream, including numbers and misspellings
+ * which fall through every comparison.
+ */
+static const char *Bench_tokens[] = {
+    "forward", "addr", "speed", "reverse", "ad", "sp", "stop", "all",
+    "fw", "rv", "show", "status", "cache", "clear", "help", "raw",
+    "speeed", "foo"
+};
+
+#define BENCH_NUM_TOKENS (sizeof(Bench_tokens) / sizeof(Bench_tokens[0]))
+
+static int Bench_chain_lookup(const char *tok, int tok_i);
+static double Bench_now(void);
+static double Bench_run(int (*lookup)(const char *, int), const char **tokens,
+    int ntokens, int rounds);
+static int Bench_hash_lookup(const char *tok, int tok_i);
+
+int
+main(int argc, char **argv)
+{
+    int i, rounds = BENCH_ROUNDS;
+    double hash_rate, chain_rate;
+
+    if(argc > 1)
+        rounds = atoi(argv[1]);
+
+    /* Sanity check that both recognisers agree. */
+    for(i=0; i < BENCH_NUM_TOKENS; i++)
+    {
+        if(Bench_hash_lookup(Bench_tokens[i], strlen(Bench_tokens[i]))
+            != Bench_chain_lookup(Bench_tokens[i], strlen(Bench_tokens[i])))
+        {
+            fprintf(stderr, "mismatch on \"%s\"\n", Bench_tokens[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    hash_rate = Bench_run(Bench_hash_lookup, Bench_tokens, BENCH_NUM_TOKENS, rounds);
+    chain_rate = Bench_run(Bench_chain_lookup, Bench_tokens, BENCH_NUM_TOKENS, rounds);
+
+    printf("mixed token stream (%d tokens x %d rounds)\n",
+        (int) BENCH_NUM_TOKENS, rounds);
+    printf("  perfect hash:\t%.0f tokens/s\n", hash_rate);
+    printf("  strcmp chain:\t%.0f tokens/s\n", chain_rate);
+    printf("  speedup:\t%.2fx\n\n", hash_rate / chain_rate);
+
+    printf("per keyword (tokens/s)\n");
+    printf("  %-10s\t%12s\t%12s\n", "token", "hash", "chain");
+    for(i=0; i < BENCH_NUM_TOKENS; i++)
+    {
+        printf("  %-10s\t%12.0f\t%12.0f\n", Bench_tokens[i],
+            Bench_run(Bench_hash_lookup, &Bench_tokens[i], 1, rounds),
+            Bench_run(Bench_chain_lookup, &Bench_tokens[i], 1, rounds));
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static double
+Bench_run(int (*lookup)(const char *, int), const char **tokens,
+    int ntokens, int rounds)
+{
+    int i, j, len[BENCH_NUM_TOKENS];
+    volatile int sink = 0;
+    double start;
+
+    for(j=0; j < ntokens; j++)
+        len[j] = strlen(tokens[j]);
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+    {
+        for(j=0; j < ntokens; j++)
+            sink += lookup(tokens[j], len[j]);
+    }
+
+    return ((double) rounds * ntokens) / (Bench_now() - start);
+}
+
+static double
+Bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int
+Bench_hash_lookup(const char *tok, int tok_i)
+{
+    return DSL_kw_lookup(tok, tok_i);
+}
+
+/**
+ * The keyword comparison chain previously used by DSL_next_token.
+ */
+static int
+Bench_chain_lookup(const char *tok, int tok_i)
+{
+    if(DSL_CMP(tok, tok_i, "raw"))
+        return DSL_TOK_RAW;
+    else if(DSL_CMP(tok, tok_i, "forward") || DSL_CMP(tok, tok_i, "fw"))
+        return DSL_TOK_FORWARD;
+    else if(DSL_CMP(tok, tok_i, "reverse") || DSL_CMP(tok, tok_i, "rv"))
+        return DSL_TOK_REVERSE;
+    else if(DSL_CMP(tok, tok_i, "stop"))
+        return DSL_TOK_STOP;
+    else if(DSL_CMP(tok, tok_i, "addr") || DSL_CMP(tok, tok_i, "ad"))
+        return DSL_TOK_ADDR;
+    else if(DSL_CMP(tok, tok_i, "speed") || DSL_CMP(tok, tok_i, "sp"))
+        return DSL_TOK_SPEED;
+    else if(DSL_CMP(tok, tok_i, "all"))
+        return DSL_TOK_ALL;
+    else if(DSL_CMP(tok, tok_i, "show"))
+        return DSL_TOK_SHOW;
+    else if(DSL_CMP(tok, tok_i, "cache"))
+        return DSL_TOK_CACHE;
+    else if(DSL_CMP(tok, tok_i, "clear"))
+        return DSL_TOK_CLEAR;
+    else if(DSL_CMP(tok, tok_i, "status"))
+        return DSL_TOK_STATUS;
+    else if(DSL_CMP(tok, tok_i, "help"))
+        return DSL_TOK_HELP;
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file hot_bench.c
+ * @brief Host microbenchmarks of the packet, parser and cache hot paths.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Measures, on the build host and against the modules of the native build:
+ *
+ * - baseline loco packets built per second, from the pool and back,
+ * - packets framed from data bytes per second,
+ * - DSL tokens and lines scanned and parsed per second,
+ * - refresh cache updates and refreshes per second.
+ *
+ * The figures are host figures, useful for comparing changes to these
+ * paths rather than as target timings (see make bench-avr for those).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dcc.h"
+#include "dsl.h"
+#include "cache.h"
+
+#define BENCH_ROUNDS 1000000
+
+/**
+ * A representative session, one command per line.
+ */
+static const char *Bench_lines[] = {
+    "forward addr 3 speed 5\n",
+    "reverse speed 12 addr 44\n",
+    "#17 forward addr 10 speed 28\n",
+    "stop addr 3\n",
+    "rawdata 0x0374\n",
+    "raw 0xfff05190dd\n",
+    "show status\n",
+    "cache show 10\n",
+    "stop all\n",
+    "forward addr 127 speed 1\n"
+};
+
+#define BENCH_NUM_LINES (sizeof(Bench_lines) / sizeof(Bench_lines[0]))
+
+static double Bench_now(void);
+static double Bench_packets(int rounds);
+static double Bench_framed(int rounds);
+static double Bench_parse(int rounds, int *tokens, int *chars);
+static double Bench_cache_update(int rounds);
+static double Bench_cache_refresh(int rounds);
+
+int
+main(int argc, char **argv)
+{
+    int rounds = BENCH_ROUNDS, tokens, chars;
+    double lines;
+
+    if(argc > 1)
+        rounds = atoi(argv[1]);
+
+    DSL_module_init();
+    Cache_module_init();
+
+    printf("packets built:\t\t%12.0f /s\n", Bench_packets(rounds));
+    printf("packets framed:\t\t%12.0f /s\n", Bench_framed(rounds));
+
+    lines = Bench_parse(rounds / 10, &tokens, &chars);
+    printf("lines parsed:\t\t%12.0f /s\n", lines);
+    printf("tokens scanned:\t\t%12.0f /s\n", lines * tokens / BENCH_NUM_LINES);
+    printf("chars scanned:\t\t%12.0f /s\n", lines * chars / BENCH_NUM_LINES);
+
+    printf("cache updates:\t\t%12.0f /s\n", Bench_cache_update(rounds));
+    printf("cache refreshes:\t%12.0f /s\n", Bench_cache_refresh(rounds));
+
+    return EXIT_SUCCESS;
+}
+
+static double
+Bench_packets(int rounds)
+{
+    DCC_packet_T packet;
+    double start;
+    int i;
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+    {
+        packet = DCC_baseline_packet_create();
+        DCC_set_preamble(packet);
+        DCC_set_address(packet, i & 0x7F);
+        DCC_set_speed_direction_preamble(packet);
+        DCC_set_direction(packet, i & 1);
+        DCC_set_speed(packet, i % DCC_MAX_SPEED_STEPS);
+        DCC_set_checksum(packet);
+        DCC_set_packet_end(packet);
+        DCC_packet_destroy(packet);
+    }
+
+    return rounds / (Bench_now() - start);
+}
+
+static double
+Bench_framed(int rounds)
+{
+    unsigned char data[2] = { 0x03, 0x74 };
+    double start;
+    int i;
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+    {
+        data[0] = i & 0x7F;
+        DCC_packet_destroy(DCC_framed_packet_create(data, sizeof(data)));
+    }
+
+    return rounds / (Bench_now() - start);
+}
+
+/**
+ * Parse the session repeatedly.
+ *
+ * @return Lines per second, with the tokens and characters in one pass
+ *  over the session.
+ */
+static double
+Bench_parse(int rounds, int *tokens, int *chars)
+{
+    struct DSL_result_T result;
+    const char *c;
+    double start;
+    int i, j, in_token;
+
+    /* Whitespace separated words, as the scanner sees them. */
+    *tokens = *chars = 0;
+    for(j=0; j < BENCH_NUM_LINES; j++)
+    {
+        for(c = Bench_lines[j], in_token = 0; *c != '\0'; c++, (*chars)++)
+        {
+            if(*c == ' ' || *c == '\n')
+                in_token = 0;
+            else if(!in_token && (in_token = 1))
+                (*tokens)++;
+        }
+    }
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+    {
+        for(j=0; j < BENCH_NUM_LINES; j++)
+        {
+            for(c = Bench_lines[j]; *c != '\0'; c++)
+            {
+                if(DSL_parser_feed(*c, &result) == DSL_PARSE_OK
+                    && result.type != DSL_RES_TYPE_SYS)
+                {
+                    DCC_packet_destroy(result.payload.packet);
+                }
+            }
+        }
+    }
+
+    return ((double) rounds * BENCH_NUM_LINES) / (Bench_now() - start);
+}
+
+static double
+Bench_cache_update(int rounds)
+{
+    DCC_packet_T packet;
+    double start;
+    int i;
+
+    Cache_clear();
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+    {
+        /* A handful of locos, each update replacing the last packet. */
+        packet = DCC_baseline_packet_create();
+        DCC_set_address(packet, (i & 7) + 1);
+        Cache_update(packet);
+    }
+
+    return rounds / (Bench_now() - start);
+}
+
+static double
+Bench_cache_refresh(int rounds)
+{
+    volatile DCC_packet_T sink;
+    double start, secs;
+    int i;
+
+    start = Bench_now();
+    for(i=0; i < rounds; i++)
+        sink = Cache_get_next_packet();
+    secs = Bench_now() - start;
+
+    (void) sink;
+    Cache_clear();
+
+    return rounds / secs;
+}
+
+static double
+Bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file timing.c
+ * @brief Implements the interrupt handler timing instrumentation.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "hal.h"
+#include "timing.h"
+
+#ifdef TIMING_ENABLED
+
+struct Timing_stats Timing_stats[TIMING_NUM_ISRS];
+
+static const char Timing_name_scheduler[] PROGMEM = "scheduler";
+static const char Timing_name_signal[] PROGMEM = "signal";
+
+static PGM_P const Timing_names[TIMING_NUM_ISRS] PROGMEM = {
+    Timing_name_scheduler,
+    Timing_name_signal
+};
+
+extern void
+Timing_module_init(void)
+{
+    memset(Timing_stats, 0, sizeof(Timing_stats));
+
+    Hal_timing_timer_init();
+}
+
+extern void
+Timing_report(int machine)
+{
+    struct Timing_stats stats;
+    PGM_P name;
+    int i, j;
+
+    printf_P(machine ? PSTR("timing") : PSTR("isr timing details (cpu cycles)\n"));
+    for(i=0; i < TIMING_NUM_ISRS; i++)
+    {
+        /* The handlers update the statistics as we go. */
+        HAL_IRQ_DISABLE();
+        stats = Timing_stats[i];
+        HAL_IRQ_ENABLE();
+
+        name = HAL_PGM_READ_PTR(&Timing_names[i]);
+
+        if(machine)
+        {
+            printf_P(PSTR(" %S_calls=%" PRIu32 " %S_min=%u %S_max=%u %S_mean=%" PRIu32 " %S_hist="),
+                     name, stats.count, name, stats.min * TIMING_CYCLES_PER_TICK,
+                     name, stats.max * TIMING_CYCLES_PER_TICK, name, (stats.count == 0 ? 0
+                     : (stats.total * TIMING_CYCLES_PER_TICK) / stats.count), name);
+            for(j=0; j < TIMING_BUCKETS - 1; j++)
+                printf_P(PSTR("<%u:%u,"), (64U << j), stats.hist[j]);
+            printf_P(PSTR(">=%u:%u"), (64U << (j - 1)), stats.hist[j]);
+            continue;
+        }
+
+        printf_P(PSTR("  %S_calls:\t%" PRIu32 "\n"), name, stats.count);
+        printf_P(PSTR("  %S_min:\t%u\n"), name,
+                 stats.min * TIMING_CYCLES_PER_TICK);
+        printf_P(PSTR("  %S_max:\t%u\n"), name,
+                 stats.max * TIMING_CYCLES_PER_TICK);
+        printf_P(PSTR("  %S_mean:\t%" PRIu32 "\n"), name, (stats.count == 0 ? 0
+                 : (stats.total * TIMING_CYCLES_PER_TICK) / stats.count));
+
+        /* Bucket j holds times below 64 << j cycles, the last the rest. */
+        printf_P(PSTR("  %S_hist:\t"), name);
+        for(j=0; j < TIMING_BUCKETS - 1; j++)
+            printf_P(PSTR("<%u:%u "), (64U << j), stats.hist[j]);
+        printf_P(PSTR(">=%u:%u\n"), (64U << (j - 1)), stats.hist[j]);
+    }
+    printf_P(PSTR("\n"));
+}
+
+#else
+
+extern void
+Timing_module_init(void)
+{
+}
+
+extern void
+Timing_report(int machine)
+{
+    if(machine)
+        printf_P(PSTR("timing enabled=0\n"));
+    else
+        printf_P(PSTR("isr timing disabled, rebuild with TIMING_ENABLED\n\n"));
+}
+
+#endif
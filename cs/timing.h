@@ -0,0 +1,116 @@
+/**
+ * @file timing.h
+ * @brief Defines the interrupt handler timing instrumentation.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The scheduler and signal interrupt handlers must finish well within the
+ * shortest DCC half bit, otherwise the signal timing drifts out of
+ * tolerance. This module measures each handler with the otherwise unused
+ * 8 bit TIMER2, which is restarted on entry and read on exit.
+ *
+ * TIMER2 runs with a prescaler of 8, so one count is 8 cpu cycles and the
+ * counter wraps after 2048 cycles (139 microseconds). The overflow flag
+ * extends the range to 4096 cycles. A handler running longer than that
+ * is under-reported, but it is far beyond any sane handler and has long
+ * since broken the signal timing anyway. On a host build the counter
+ * measures host time instead, converted to cycles at F_CPU.
+ *
+ * The instrumentation is enabled by defining TIMING_ENABLED (see the
+ * Makefile). Otherwise the macros expand to nothing and TIMER2 is left
+ * alone.
+ */
+
+#ifndef TIMING_DEFINED
+#define TIMING_DEFINED
+
+#include <stdint.h>
+
+#include "hal.h"
+
+#define TIMING_ISR_SCHEDULER    0   /**< The TIMER0 scheduler handler. */
+#define TIMING_ISR_SIGNAL       1   /**< The TIMER1 signal handler. */
+#define TIMING_NUM_ISRS         2
+
+#define TIMING_CYCLES_PER_TICK  HAL_TIMING_PRESCALE
+#define TIMING_BUCKETS          7   /**< Histogram buckets, see Timing_report(). */
+
+/**
+ * The accumulated measurements for one interrupt handler, in TIMER2 counts.
+ */
+struct Timing_stats
+{
+    uint16_t min;
+    uint16_t max;
+    uint32_t total;
+    uint32_t count;
+    uint16_t hist[TIMING_BUCKETS];
+};
+
+#ifdef TIMING_ENABLED
+
+extern struct Timing_stats Timing_stats[TIMING_NUM_ISRS];
+
+/**
+ * Start timing a handler. Interrupt handlers do not nest, so the single
+ * counter may be shared between them.
+ */
+#define TIMING_ENTER()      HAL_TIMING_START()
+
+/**
+ * Stop timing a handler and record the measurement.
+ */
+#define TIMING_EXIT(isr)    Timing_record(&Timing_stats[(isr)], HAL_TIMING_COUNT(), \
+                                HAL_TIMING_OVERFLOW())
+
+/**
+ * Record one measurement. This is inlined into the handlers, as a call
+ * would force them to save every call clobbered register.
+ */
+static inline void
+Timing_record(struct Timing_stats *stats, uint8_t ticks, uint8_t overflow)
+{
+    uint16_t t = ticks;
+    uint8_t bucket = 0;
+
+    if(overflow)
+        t += 256;
+
+    if(stats->count == 0 || t < stats->min)
+        stats->min = t;
+
+    if(t > stats->max)
+        stats->max = t;
+
+    stats->total += t;
+    stats->count++;
+
+    /* Power of two buckets, starting below 8 counts (64 cycles). */
+    for(t >>= 3; t > 0 && bucket < (TIMING_BUCKETS - 1); t >>= 1)
+        bucket++;
+
+    stats->hist[bucket]++;
+}
+
+#else
+
+#define TIMING_ENTER()
+#define TIMING_EXIT(isr)
+
+#endif
+
+/**
+ * Start TIMER2 as the free running measurement counter.
+ */
+extern void Timing_module_init(void);
+
+/**
+ * Print the minimum, maximum and mean handler execution times along with
+ * a histogram for each instrumented interrupt handler.
+ *
+ * @param machine Non-zero to print a single line of key=value pairs, with
+ *  each histogram as a comma separated list of bound:count.
+ */
+extern void Timing_report(int machine);
+
+#endif
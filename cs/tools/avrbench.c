@@ -0,0 +1,475 @@
+/**
+ * @file avrbench.c
+ * @brief Cycle accurate interrupt budget benchmark of the firmware image.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This host program runs the AVR firmware image (cs.out) instruction by
+ * instruction under simavr, types a script of commands into the USART and
+ * measures, in cpu cycles:
+ *
+ * - every interrupt handler, from the vector to its reti, with the
+ *   shortest interval between two of its interrupts and so the share of
+ *   that interval the slowest run used (the signal handler must finish
+ *   within the shortest half bit, about 850 cycles),
+ * - each command, from its newline reaching the USART to the prompt
+ *   coming back, which is the latency of the main loop,
+ * - the longest stretch the main loop ran with interrupts disabled, which
+ *   delays every handler by as much,
+ * - the deepest the stack reached.
+ *
+ * Unlike the native build, which measures host time, these figures are
+ * those of the target, and repeat exactly from run to run.
+ *
+ * @code
+ * avrbench [-m mcu] [-f hz] [-b baud] [-i script] [-t ms] [-v] cs.out
+ * @endcode
+ *
+ * The script is read from stdin if none is given; each line is sent once
+ * the prompt for the last has come back. -t sets the time to run after
+ * the script ends, -v copies the USART output to stdout. The interrupt
+ * names are those of the ATmega644P and ATmega1284P.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+#include <avr_uart.h>
+
+#define BENCH_MCU           "atmega644p"
+#define BENCH_FREQUENCY     14745600    /**< F_CPU, see config.h. */
+#define BENCH_BAUD          9600        /**< CONFIG_BAUD_RATE, see config.h. */
+#define BENCH_LINGER_MS     100
+#define BENCH_BOOT_MS       50          /**< Time allowed to boot before typing. */
+#define BENCH_REPLY_MS      2000        /**< Time allowed for each reply. */
+#define BENCH_PROMPT        "freedcc> "
+#define BENCH_MAX_LINE      128
+#define BENCH_MAX_NEST      8
+#define BENCH_MAX_VECTORS   64
+
+#define BENCH_OP_RETI       0x9518
+
+/**
+ * Cycle counts of one interrupt handler.
+ */
+struct Bench_isr
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t min, max;
+    uint64_t last;          /**< Cycle of the last entry. */
+    uint64_t interval;      /**< Shortest time between entries. */
+};
+
+/**
+ * Cycle counts of the commands typed.
+ */
+struct Bench_cmd
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t min, max;
+    uint64_t timeouts;
+};
+
+static struct
+{
+    avr_t *avr;
+    FILE *script;
+    int verbose;
+    uint64_t char_cycles;       /**< Cycles to send one character. */
+    int vectors;                /**< Entries in the vector table. */
+
+    /* Handlers running, innermost last. */
+    struct
+    {
+        int vector;
+        uint64_t entry;
+    } stack[BENCH_MAX_NEST];
+    int depth;
+    struct Bench_isr isrs[BENCH_MAX_VECTORS];
+
+    /* Main loop. */
+    int running;                /**< Non-zero once interrupts are first enabled. */
+    uint64_t irq_off;           /**< Cycle interrupts were disabled, or 0. */
+    uint64_t irq_off_max;
+    uint16_t sp_min;
+
+    /* Typing. */
+    char line[BENCH_MAX_LINE];
+    int pos, len;
+    int xoff;
+    int waiting;                /**< Non-zero while waiting for a prompt. */
+    uint64_t next_char;
+    uint64_t sent;              /**< Cycle the last newline was sent. */
+    int matched;                /**< Prompt characters matched so far. */
+    struct Bench_cmd cmds;
+    avr_irq_t *uart_in;
+} Bench;
+
+static const char *Bench_vector_names[BENCH_MAX_VECTORS] = {
+    [13] = "signal (TIMER1_COMPA)",
+    [16] = "scheduler (TIMER0_COMPA)",
+    [20] = "usart rx (USART0_RX)",
+};
+
+static int Bench_vector_count(avr_t *avr);
+static void Bench_step(avr_t *avr);
+static int Bench_type(avr_t *avr);
+static void Bench_uart_out(struct avr_irq_t *irq, uint32_t value, void *param);
+static void Bench_uart_xon(struct avr_irq_t *irq, uint32_t value, void *param);
+static void Bench_uart_xoff(struct avr_irq_t *irq, uint32_t value, void *param);
+static void Bench_report(void);
+static void Bench_usage(void);
+
+int
+main(int argc, char **argv)
+{
+    elf_firmware_t firmware;
+    const char *mcu = BENCH_MCU;
+    uint32_t frequency = BENCH_FREQUENCY, baud = BENCH_BAUD, flags = 0;
+    uint64_t linger = BENCH_LINGER_MS, end = 0;
+    avr_t *avr;
+    int c;
+
+    Bench.script = stdin;
+    while((c = getopt(argc, argv, "m:f:b:i:t:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'm':
+                mcu = optarg;
+                break;
+
+            case 'f':
+                frequency = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'b':
+                baud = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'i':
+                if((Bench.script = fopen(optarg, "r")) == NULL)
+                {
+                    perror(optarg);
+                    return 2;
+                }
+                break;
+
+            case 't':
+                linger = strtoull(optarg, NULL, 10);
+                break;
+
+            case 'v':
+                Bench.verbose = 1;
+                break;
+
+            default:
+                Bench_usage();
+                return 2;
+        }
+    }
+
+    if(optind >= argc || frequency == 0 || baud == 0)
+    {
+        Bench_usage();
+        return 2;
+    }
+
+    memset(&firmware, 0, sizeof(firmware));
+    if(elf_read_firmware(argv[optind], &firmware) < 0)
+    {
+        fprintf(stderr, "avrbench: cannot read %s\n", argv[optind]);
+        return 2;
+    }
+
+    if((avr = avr_make_mcu_by_name(firmware.mmcu[0] ? firmware.mmcu : mcu)) == NULL)
+    {
+        fprintf(stderr, "avrbench: unknown mcu %s\n", mcu);
+        return 2;
+    }
+
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = frequency;
+
+    /* Take the USART output here rather than on the console. */
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+        Bench_uart_out, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XON),
+        Bench_uart_xon, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XOFF),
+        Bench_uart_xoff, NULL);
+    Bench.uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    Bench.avr = avr;
+    Bench.vectors = Bench_vector_count(avr);
+    Bench.char_cycles = (uint64_t) frequency * 10 / baud;
+    Bench.next_char = (uint64_t) frequency * BENCH_BOOT_MS / 1000;
+    Bench.sp_min = avr->ramend;
+    Bench.cmds.min = UINT64_MAX;
+    for(c=0; c < BENCH_MAX_VECTORS; c++)
+        Bench.isrs[c].min = UINT64_MAX;
+
+    while(avr->state != cpu_Done && avr->state != cpu_Crashed)
+    {
+        if(end == 0 && !Bench_type(avr))
+            end = avr->cycle + (uint64_t) frequency * linger / 1000;
+
+        if(end > 0 && avr->cycle >= end)
+            break;
+
+        Bench_step(avr);
+    }
+
+    if(avr->state == cpu_Crashed)
+        fprintf(stderr, "avrbench: the firmware crashed at pc 0x%04x\n", avr->pc);
+
+    printf("simulated:   %.3f s, %" PRIu64 " cycles at %" PRIu32 " Hz\n",
+        (double) avr->cycle / frequency, (uint64_t) avr->cycle, frequency);
+    Bench_report();
+
+    return (avr->state == cpu_Crashed ? 1 : 0);
+}
+
+/**
+ * Count the jumps at the start of flash, which make up the vector table.
+ */
+static int
+Bench_vector_count(avr_t *avr)
+{
+    uint32_t addr;
+    uint16_t op;
+    int count = 0;
+
+    for(addr = 0; (addr + 1) < avr->flashend && count < BENCH_MAX_VECTORS;
+        addr += avr->vector_size)
+    {
+        op = avr->flash[addr] | (avr->flash[addr + 1] << 8);
+        if((op & 0xFE0E) != 0x940C && (op & 0xF000) != 0xC000)
+            break;
+
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Run one instruction, or until the next event if the cpu is asleep, and
+ * account for the handlers entered and left.
+ */
+static void
+Bench_step(avr_t *avr)
+{
+    struct Bench_isr *isr;
+    uint32_t pc = avr->pc;
+    uint16_t op, sp;
+    uint64_t cycles;
+    int vector;
+
+    op = avr->flash[pc] | (avr->flash[pc + 1] << 8);
+    avr_run(avr);
+
+    if(op == BENCH_OP_RETI && Bench.depth > 0)
+    {
+        Bench.depth--;
+        isr = &Bench.isrs[Bench.stack[Bench.depth].vector];
+        cycles = avr->cycle - Bench.stack[Bench.depth].entry;
+
+        isr->total += cycles;
+        if(cycles < isr->min)
+            isr->min = cycles;
+        if(cycles > isr->max)
+            isr->max = cycles;
+    }
+
+    /* The firmware only lands on a vector when an interrupt is taken. */
+    vector = avr->pc / avr->vector_size;
+    if(avr->pc != pc && vector > 0 && vector < Bench.vectors
+        && (avr->pc % avr->vector_size) == 0 && Bench.depth < BENCH_MAX_NEST)
+    {
+        isr = &Bench.isrs[vector];
+        if(isr->count > 0 && (avr->cycle - isr->last < isr->interval || isr->interval == 0))
+            isr->interval = avr->cycle - isr->last;
+
+        isr->count++;
+        isr->last = avr->cycle;
+        Bench.stack[Bench.depth].vector = vector;
+        Bench.stack[Bench.depth].entry = avr->cycle;
+        Bench.depth++;
+    }
+
+    /* Interrupts held off by the main loop, once it has enabled them. */
+    if(avr->sreg[S_I])
+        Bench.running = 1;
+
+    if(Bench.running && Bench.depth == 0 && !avr->sreg[S_I])
+    {
+        if(Bench.irq_off == 0)
+            Bench.irq_off = avr->cycle;
+    }
+    else if(Bench.irq_off > 0)
+    {
+        if(avr->cycle - Bench.irq_off > Bench.irq_off_max)
+            Bench.irq_off_max = avr->cycle - Bench.irq_off;
+        Bench.irq_off = 0;
+    }
+
+    sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+    if(sp < Bench.sp_min)
+        Bench.sp_min = sp;
+}
+
+/**
+ * Send the next character of the script when it is due.
+ *
+ * @return 0 once the script has been sent and answered.
+ */
+static int
+Bench_type(avr_t *avr)
+{
+    if(avr->cycle < Bench.next_char || Bench.xoff)
+        return 1;
+
+    if(Bench.waiting)
+    {
+        if(avr->cycle - Bench.sent < (uint64_t) avr->frequency * BENCH_REPLY_MS / 1000)
+            return 1;
+
+        Bench.cmds.timeouts++;
+        Bench.waiting = 0;
+    }
+
+    if(Bench.pos >= Bench.len)
+    {
+        if(fgets(Bench.line, sizeof(Bench.line), Bench.script) == NULL)
+            return 0;
+
+        Bench.pos = 0;
+        Bench.len = strlen(Bench.line);
+        return 1;
+    }
+
+    avr_raise_irq(Bench.uart_in, Bench.line[Bench.pos]);
+    Bench.next_char = avr->cycle + Bench.char_cycles;
+
+    if(Bench.line[Bench.pos++] == '\n')
+    {
+        Bench.sent = avr->cycle;
+        Bench.waiting = 1;
+        Bench.matched = 0;
+    }
+
+    return 1;
+}
+
+static void
+Bench_uart_out(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    struct Bench_cmd *cmds = &Bench.cmds;
+    uint64_t cycles;
+
+    if(Bench.verbose)
+    {
+        putchar(value);
+        fflush(stdout);
+    }
+
+    if(!Bench.waiting)
+        return;
+
+    /* Look for the prompt, which ends the reply. */
+    if(value == BENCH_PROMPT[Bench.matched])
+        Bench.matched++;
+    else
+        Bench.matched = (value == BENCH_PROMPT[0]);
+
+    if(BENCH_PROMPT[Bench.matched] == '\0')
+    {
+        cycles = Bench.avr->cycle - Bench.sent;
+
+        cmds->count++;
+        cmds->total += cycles;
+        if(cycles < cmds->min)
+            cmds->min = cycles;
+        if(cycles > cmds->max)
+            cmds->max = cycles;
+
+        Bench.waiting = 0;
+    }
+}
+
+static void
+Bench_uart_xon(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    Bench.xoff = 0;
+}
+
+static void
+Bench_uart_xoff(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    Bench.xoff = 1;
+}
+
+static void
+Bench_report(void)
+{
+    struct Bench_isr *isr;
+    struct Bench_cmd *cmds = &Bench.cmds;
+    char name[32];
+    int i;
+
+    printf("\n%-26s %8s %7s %7s %7s %9s %6s\n",
+        "handler", "count", "min", "mean", "max", "interval", "load");
+    for(i=0; i < BENCH_MAX_VECTORS; i++)
+    {
+        isr = &Bench.isrs[i];
+        if(isr->count == 0 || isr->min == UINT64_MAX)
+            continue;
+
+        if(Bench_vector_names[i] != NULL)
+            snprintf(name, sizeof(name), "%s", Bench_vector_names[i]);
+        else
+            snprintf(name, sizeof(name), "vector %d", i);
+
+        printf("%-26s %8" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7" PRIu64 " %9" PRIu64,
+            name, isr->count, isr->min, isr->total / isr->count, isr->max, isr->interval);
+        if(isr->interval > 0)
+            printf(" %5.1f%%", 100.0 * isr->max / isr->interval);
+        printf("\n");
+    }
+
+    printf("\ncommands:    %" PRIu64 " answered, %" PRIu64 " timed out\n",
+        cmds->count, cmds->timeouts);
+    if(cmds->count > 0)
+    {
+        printf("latency:     %" PRIu64 " min, %" PRIu64 " mean, %" PRIu64 " max cycles"
+            " (newline to prompt)\n", cmds->min, cmds->total / cmds->count, cmds->max);
+    }
+    printf("irq off:     %" PRIu64 " cycles longest in the main loop\n", Bench.irq_off_max);
+    printf("stack:       %u bytes deepest\n", (unsigned) (Bench.avr->ramend - Bench.sp_min));
+}
+
+static void
+Bench_usage(void)
+{
+    fprintf(stderr, "usage: avrbench [-m mcu] [-f hz] [-b baud] [-i script] [-t ms] [-v] cs.out\n");
+    fprintf(stderr, "  -m mcu     the mcu, if not named in the image (default %s)\n", BENCH_MCU);
+    fprintf(stderr, "  -f hz      the cpu clock (default %d)\n", BENCH_FREQUENCY);
+    fprintf(stderr, "  -b baud    the USART rate (default %d)\n", BENCH_BAUD);
+    fprintf(stderr, "  -i script  the commands to type (default stdin)\n");
+    fprintf(stderr, "  -t ms      run time after the script ends (default %d)\n", BENCH_LINGER_MS);
+    fprintf(stderr, "  -v         copy the USART output to stdout\n");
+}
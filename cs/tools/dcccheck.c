@@ -0,0 +1,262 @@
+/**
+ * @file dcccheck.c
+ * @brief Checks a captured track signal against the NMRA standards.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This host program reads the track signal from a value change dump, such
+ * as one written by the native build with -w, decodes it with the
+ * streaming decoder and checks it against NMRA S-9.1 and S-9.2:
+ *
+ * - every half bit falls within the one or zero windows, and the halves
+ *   of each one bit are within 6us of each other,
+ * - every packet has at least the minimum preamble, 14 bits by default,
+ *   and a valid checksum,
+ * - packets to the same decoder are at least 5ms apart, from the end bit
+ *   of one to the start bit of the next.
+ *
+ * It then reports the packet and bit rates achieved, the observed half bit
+ * ranges and the violations found, and exits with 1 if there were any.
+ *
+ * @code
+ * dcccheck [-d] [-n name] [-p bits] [-g us] [file]
+ * @endcode
+ *
+ * -d prints every decoded packet, -n selects the signal by name (the first
+ * one bit signal by default), -p and -g set the minimum preamble and gap.
+ * The dump is read from stdin if no file is given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "vcd.h"
+#include "dccdec.h"
+
+#define CHECK_MIN_PREAMBLE  14      /**< S-9.2 command station preamble. */
+#define CHECK_MIN_GAP_US    5000    /**< S-9.2 time between packets to a decoder. */
+
+#define CHECK_VIOLATION_PREAMBLE    0
+#define CHECK_VIOLATION_CHECKSUM    1
+#define CHECK_VIOLATION_GAP         2
+#define CHECK_NUM_VIOLATIONS        3
+
+struct Check
+{
+    int dump;
+    unsigned min_preamble;
+    uint64_t min_gap;               /**< In ns. */
+    uint64_t violations[CHECK_NUM_VIOLATIONS];
+    unsigned preamble_min, preamble_max;
+    uint64_t gap_min;
+    uint64_t last[DCCDEC_NUM_ADDRS];    /**< End of the last packet to each decoder, or 0. */
+    uint64_t bytes;
+};
+
+static const char *Check_violation_names[CHECK_NUM_VIOLATIONS] = {
+    "short preamble",
+    "bad checksum",
+    "packets to a decoder too close"
+};
+
+static void Check_packet(void *ctx, const struct Dccdec_packet *packet);
+static void Check_error(void *ctx, int err, uint64_t time);
+static void Check_violation(struct Check *check, int violation, uint64_t time);
+static void Check_usage(void);
+
+static struct Check Check;
+
+int
+main(int argc, char **argv)
+{
+    struct Vcd_T vcd;
+    struct Dccdec_T dec;
+    struct Dccdec_stats *stats = &dec.stats;
+    const char *name = NULL;
+    uint64_t time = 0, first = 0, total = 0;
+    FILE *in = stdin;
+    double secs;
+    int c, value, i;
+
+    Check.min_preamble = CHECK_MIN_PREAMBLE;
+    Check.min_gap = CHECK_MIN_GAP_US * 1000ULL;
+    Check.preamble_min = UINT32_MAX;
+    Check.gap_min = UINT64_MAX;
+
+    while((c = getopt(argc, argv, "dn:p:g:")) != -1)
+    {
+        switch(c)
+        {
+            case 'd':
+                Check.dump = 1;
+                break;
+
+            case 'n':
+                name = optarg;
+                break;
+
+            case 'p':
+                Check.min_preamble = atoi(optarg);
+                break;
+
+            case 'g':
+                Check.min_gap = strtoull(optarg, NULL, 10) * 1000;
+                break;
+
+            default:
+                Check_usage();
+                return 2;
+        }
+    }
+
+    if(optind < argc && (in = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    if(Vcd_open(&vcd, in, name) < 0)
+    {
+        fprintf(stderr, "dcccheck: no %s signal in the dump\n", (name ? name : "one bit"));
+        return 2;
+    }
+
+    Dccdec_init(&dec, Check_packet, Check_error, &Check);
+    while(Vcd_next_edge(&vcd, &time, &value))
+    {
+        if(!dec.started)
+            first = time;
+        Dccdec_edge(&dec, time);
+    }
+
+    total = time - first;
+    secs = total / 1e9;
+
+    printf("signal:       %.3f s, %" PRIu64 " half bits, %" PRIu64 " ones, %" PRIu64 " zeros\n",
+        secs, stats->halves, stats->ones, stats->zeros);
+    printf("packets:      %" PRIu64 " framed, %" PRIu64 " bad checksums\n",
+        stats->packets, stats->bad_checksums);
+    if(total > 0)
+    {
+        printf("throughput:   %.1f packets/s, %.1f bits/s, %.1f data bytes/s\n",
+            stats->packets / secs, (stats->ones + stats->zeros) / secs, Check.bytes / secs);
+    }
+    if(stats->one_max > 0)
+    {
+        printf("one halves:   %.2f - %.2f us\n",
+            stats->one_min / 1e3, stats->one_max / 1e3);
+    }
+    if(stats->zero_max > 0)
+    {
+        printf("zero halves:  %.2f - %.2f us\n",
+            stats->zero_min / 1e3, stats->zero_max / 1e3);
+    }
+    if(stats->packets > 0)
+    {
+        printf("preamble:     %u - %u bits\n", Check.preamble_min, Check.preamble_max);
+    }
+    if(Check.gap_min != UINT64_MAX)
+    {
+        printf("decoder gap:  %.3f ms minimum\n", Check.gap_min / 1e6);
+    }
+
+    c = 0;
+    for(i=0; i < DCCDEC_NUM_ERRS; i++)
+    {
+        if(stats->errors[i] > 0)
+        {
+            printf("violation:    %s, %" PRIu64 "\n", Dccdec_error_name(i), stats->errors[i]);
+            c = 1;
+        }
+    }
+    for(i=0; i < CHECK_NUM_VIOLATIONS; i++)
+    {
+        if(Check.violations[i] > 0)
+        {
+            printf("violation:    %s, %" PRIu64 "\n", Check_violation_names[i],
+                Check.violations[i]);
+            c = 1;
+        }
+    }
+
+    printf("result:       %s\n", (c ? "FAIL" : "ok"));
+
+    return c;
+}
+
+static void
+Check_packet(void *ctx, const struct Dccdec_packet *packet)
+{
+    struct Check *check = ctx;
+    int addr, i;
+
+    if(check->dump)
+    {
+        printf("%12.6f ms  %2u ", packet->start / 1e6, packet->preamble);
+        for(i=0; i < packet->size; i++)
+            printf(" %02x", packet->bytes[i]);
+        printf("%s\n", (packet->valid ? "" : "  bad checksum"));
+    }
+
+    check->bytes += packet->size;
+
+    if(packet->preamble < check->preamble_min)
+        check->preamble_min = packet->preamble;
+    if(packet->preamble > check->preamble_max)
+        check->preamble_max = packet->preamble;
+
+    if(packet->preamble < check->min_preamble)
+        Check_violation(check, CHECK_VIOLATION_PREAMBLE, packet->start);
+
+    if(!packet->valid)
+    {
+        Check_violation(check, CHECK_VIOLATION_CHECKSUM, packet->start);
+        return;
+    }
+
+    if((addr = Dccdec_address(packet)) == DCCDEC_ADDR_NONE)
+        return;
+
+    if(check->last[addr] > 0)
+    {
+        if((packet->start - check->last[addr]) < check->gap_min)
+            check->gap_min = packet->start - check->last[addr];
+
+        if((packet->start - check->last[addr]) < check->min_gap)
+            Check_violation(check, CHECK_VIOLATION_GAP, packet->start);
+    }
+
+    check->last[addr] = packet->end;
+}
+
+static void
+Check_error(void *ctx, int err, uint64_t time)
+{
+    struct Check *check = ctx;
+
+    if(check->dump)
+        printf("%12.6f ms  %s\n", time / 1e6, Dccdec_error_name(err));
+}
+
+static void
+Check_violation(struct Check *check, int violation, uint64_t time)
+{
+    check->violations[violation]++;
+
+    if(check->dump)
+        printf("%12.6f ms  %s\n", time / 1e6, Check_violation_names[violation]);
+}
+
+static void
+Check_usage(void)
+{
+    fprintf(stderr, "usage: dcccheck [-d] [-n name] [-p bits] [-g us] [file]\n");
+    fprintf(stderr, "  -d        print every packet and error\n");
+    fprintf(stderr, "  -n name   the signal to check (default the first one bit signal)\n");
+    fprintf(stderr, "  -p bits   minimum preamble (default %d)\n", CHECK_MIN_PREAMBLE);
+    fprintf(stderr, "  -g us     minimum time between packets to a decoder (default %d)\n",
+        CHECK_MIN_GAP_US);
+}
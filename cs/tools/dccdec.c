@@ -0,0 +1,366 @@
+/**
+ * @file dccdec.c
+ * @brief Implements the streaming DCC signal decoder.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "dccdec.h"
+#include "../dcc.h"
+
+#define T                       Dccdec_T
+
+#define DCCDEC_STATE_PREAMBLE   0   /**< Counting preamble halves. */
+#define DCCDEC_STATE_START      1   /**< Expecting the second half of the start bit. */
+#define DCCDEC_STATE_DATA       2   /**< Expecting the first half of a data bit. */
+#define DCCDEC_STATE_DATA2      3   /**< Expecting the second half of a data bit. */
+
+static void Dccdec_step(T dec, uint64_t start, uint32_t ns, int kind);
+static void Dccdec_bit(T dec, int bit, uint64_t time);
+static void Dccdec_error(T dec, int err, uint64_t time, unsigned shorts);
+static void Dccdec_emit(T dec, uint64_t end);
+
+static const char *Dccdec_error_names[DCCDEC_NUM_ERRS] = {
+    "half bit out of range",
+    "one bit halves skewed",
+    "bit halves differ",
+    "short preamble",
+    "packet too long"
+};
+
+extern void
+Dccdec_init(T dec, Dccdec_packet_fn on_packet, Dccdec_error_fn on_error, void *ctx)
+{
+    memset(dec, 0, sizeof(*dec));
+
+    dec->on_packet = on_packet;
+    dec->on_error = on_error;
+    dec->ctx = ctx;
+    dec->state = DCCDEC_STATE_PREAMBLE;
+    dec->stats.one_min = dec->stats.zero_min = UINT32_MAX;
+}
+
+extern void
+Dccdec_edge(T dec, uint64_t time)
+{
+    if(dec->started)
+    {
+        Dccdec_half(dec, dec->edge, (time - dec->edge) > UINT32_MAX
+            ? UINT32_MAX : (uint32_t) (time - dec->edge));
+    }
+
+    dec->started = 1;
+    dec->edge = time;
+}
+
+extern void
+Dccdec_edges(T dec, const uint64_t *times, size_t n)
+{
+    uint32_t ns[DCCDEC_BLOCK];
+    int8_t kind[DCCDEC_BLOCK];
+    uint64_t start;
+    size_t i, j, len;
+
+    if(n == 0)
+        return;
+
+    if(!dec->started)
+    {
+        dec->started = 1;
+        dec->edge = times[0];
+        times++;
+        n--;
+    }
+
+    for(i=0; i < n; i += len)
+    {
+        len = (n - i < DCCDEC_BLOCK ? n - i : DCCDEC_BLOCK);
+
+        start = dec->edge;
+        for(j=0; j < len; j++)
+        {
+            ns[j] = ((times[i + j] - start) > UINT32_MAX
+                ? UINT32_MAX : (uint32_t) (times[i + j] - start));
+            start = times[i + j];
+        }
+
+        Dccdec_classify(ns, kind, len);
+
+        for(j=0; j < len; j++)
+        {
+            Dccdec_step(dec, dec->edge, ns[j], kind[j]);
+            dec->edge = times[i + j];
+        }
+    }
+}
+
+extern void
+Dccdec_half(T dec, uint64_t start, uint32_t ns)
+{
+    Dccdec_step(dec, start, ns, DCCDEC_CLASSIFY(ns));
+}
+
+extern void
+Dccdec_classify(const uint32_t *ns, int8_t *kind, size_t n)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    /* SSE2 compares are signed, so bias both sides to compare unsigned. */
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i one_lo = _mm_set1_epi32(DCCDEC_ONE_MIN - 1 + INT32_MIN);
+    const __m128i one_hi = _mm_set1_epi32(DCCDEC_ONE_MAX + 1 + INT32_MIN);
+    const __m128i zero_lo = _mm_set1_epi32(DCCDEC_ZERO_MIN - 1 + INT32_MIN);
+    const __m128i zero_hi = _mm_set1_epi32(DCCDEC_ZERO_MAX + 1 + INT32_MIN);
+    const __m128i all = _mm_set1_epi32(-1);
+    __m128i v[2], one, zero;
+    int k;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        for(k=0; k < 2; k++)
+        {
+            v[k] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (ns + i + (k * 4))), bias);
+
+            /* Each lane is all ones if within the window. */
+            one = _mm_and_si128(_mm_cmpgt_epi32(v[k], one_lo), _mm_cmplt_epi32(v[k], one_hi));
+            zero = _mm_and_si128(_mm_cmpgt_epi32(v[k], zero_lo), _mm_cmplt_epi32(v[k], zero_hi));
+
+            /* Neither is -1 - 0, a zero 0 - 0 and a one 0 - -1. */
+            v[k] = _mm_sub_epi32(_mm_andnot_si128(_mm_or_si128(one, zero), all), one);
+        }
+
+        _mm_storel_epi64((__m128i *) (kind + i),
+            _mm_packs_epi16(_mm_packs_epi32(v[0], v[1]), _mm_setzero_si128()));
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        kind[i] = (int8_t) ((ns[i] >= DCCDEC_ONE_MIN) & (ns[i] <= DCCDEC_ONE_MAX))
+            - (int8_t) (((ns[i] < DCCDEC_ZERO_MIN) | (ns[i] > DCCDEC_ZERO_MAX))
+                & ((ns[i] < DCCDEC_ONE_MIN) | (ns[i] > DCCDEC_ONE_MAX)));
+    }
+}
+
+/**
+ * Take a half bit of the given kind, as classified.
+ */
+static void
+Dccdec_step(T dec, uint64_t start, uint32_t ns, int kind)
+{
+    struct Dccdec_stats *stats = &dec->stats;
+
+    stats->halves++;
+    if(kind == 1)
+    {
+        if(ns < stats->one_min)
+            stats->one_min = ns;
+        if(ns > stats->one_max)
+            stats->one_max = ns;
+    }
+    else if(kind == 0)
+    {
+        if(ns < stats->zero_min)
+            stats->zero_min = ns;
+        if(ns > stats->zero_max)
+            stats->zero_max = ns;
+    }
+    else
+    {
+        Dccdec_error(dec, DCCDEC_ERR_HALF, start, 0);
+        return;
+    }
+
+    switch(dec->state)
+    {
+        case DCCDEC_STATE_PREAMBLE:
+            if(kind == 1)
+            {
+                dec->shorts++;
+            }
+            else if((dec->shorts / 2) < DCCDEC_MIN_PREAMBLE)
+            {
+                /* Zeros with no preamble ahead of them, look for the next. */
+                if(dec->shorts > 0)
+                    Dccdec_error(dec, DCCDEC_ERR_PREAMBLE, start, 0);
+                dec->shorts = 0;
+            }
+            else
+            {
+                dec->packet.start = start;
+                dec->packet.preamble = dec->shorts / 2;
+                dec->packet.size = 0;
+                dec->state = DCCDEC_STATE_START;
+            }
+            break;
+
+        case DCCDEC_STATE_START:
+            if(kind == 1)
+            {
+                Dccdec_error(dec, DCCDEC_ERR_MIXED, start, 1);
+            }
+            else
+            {
+                stats->zeros++;
+                dec->bits = 0;
+                dec->byte = 0;
+                dec->state = DCCDEC_STATE_DATA;
+            }
+            break;
+
+        case DCCDEC_STATE_DATA:
+            dec->first = kind;
+            dec->first_ns = ns;
+            dec->state = DCCDEC_STATE_DATA2;
+            break;
+
+        case DCCDEC_STATE_DATA2:
+            if(kind != dec->first)
+            {
+                Dccdec_error(dec, DCCDEC_ERR_MIXED, start, kind);
+                break;
+            }
+
+            if(kind == 1)
+            {
+                /* The skew is reported, but the bit is still taken. */
+                if((ns > dec->first_ns ? ns - dec->first_ns : dec->first_ns - ns)
+                    > DCCDEC_ONE_SKEW)
+                {
+                    stats->errors[DCCDEC_ERR_SKEW]++;
+                    if(dec->on_error != NULL)
+                        dec->on_error(dec->ctx, DCCDEC_ERR_SKEW, start);
+                }
+                stats->ones++;
+            }
+            else
+            {
+                stats->zeros++;
+            }
+
+            dec->state = DCCDEC_STATE_DATA;
+            Dccdec_bit(dec, kind, start + ns);
+            break;
+    }
+}
+
+extern int
+Dccdec_address(const struct Dccdec_packet *packet)
+{
+    const uint8_t *b = packet->bytes;
+
+    if(packet->size < 3 || b[0] == 0xFF)
+        return DCCDEC_ADDR_NONE;
+
+    if(b[0] < 128)
+        return b[0];
+
+    /* Accessories, with the high address bits complemented in the second byte. */
+    if(b[0] < 192)
+        return DCCDEC_ADDR_ACCESSORY + ((b[0] & 0x3F) | ((~b[1] & 0x70) << 2));
+
+    if(b[0] < 232)
+        return DCCDEC_ADDR_LONG + (((b[0] & 0x3F) << 8) | b[1]);
+
+    return DCCDEC_ADDR_NONE;
+}
+
+extern int
+Dccdec_speed(uint8_t instruction, int *direction)
+{
+    int code = instruction & 0x1F;
+
+    if((instruction & 0xC0) != 0x40)
+        return -1;
+
+    *direction = ((instruction & 0x20) ? DCC_DIRECTION_FORWARD : DCC_DIRECTION_REVERSE);
+
+    /* The C bit is the low bit of the step, codes 0 and 1 stop. */
+    if((code & 0x0F) < 2)
+        return 0;
+
+    return ((code & 0x0F) - 2) * 2 + 1 + (code >> 4);
+}
+
+extern const char *
+Dccdec_error_name(int err)
+{
+    return (err >= 0 && err < DCCDEC_NUM_ERRS ? Dccdec_error_names[err] : "unknown");
+}
+
+/**
+ * Take a data or separator bit, ending at the given time.
+ */
+static void
+Dccdec_bit(T dec, int bit, uint64_t time)
+{
+    if(dec->bits < 8)
+    {
+        dec->byte = (dec->byte << 1) | bit;
+        dec->bits++;
+        return;
+    }
+
+    /* The bit after each byte separates it from the next, or ends the packet. */
+    if(dec->packet.size >= DCCDEC_MAX_BYTES)
+    {
+        Dccdec_error(dec, DCCDEC_ERR_LONG, time, 0);
+        return;
+    }
+
+    dec->packet.bytes[dec->packet.size++] = dec->byte;
+    dec->bits = 0;
+    dec->byte = 0;
+
+    if(bit == 1)
+    {
+        Dccdec_emit(dec, time);
+
+        /* The end bit may also be the first bit of the next preamble. */
+        dec->shorts = 2;
+        dec->state = DCCDEC_STATE_PREAMBLE;
+    }
+}
+
+/**
+ * Report an error and look for the next preamble, counting the given one
+ * halves already seen towards it.
+ */
+static void
+Dccdec_error(T dec, int err, uint64_t time, unsigned shorts)
+{
+    dec->stats.errors[err]++;
+    if(dec->on_error != NULL)
+        dec->on_error(dec->ctx, err, time);
+
+    dec->shorts = shorts;
+    dec->state = DCCDEC_STATE_PREAMBLE;
+}
+
+static void
+Dccdec_emit(T dec, uint64_t end)
+{
+    struct Dccdec_packet *packet = &dec->packet;
+    uint8_t check = 0;
+    int i;
+
+    for(i=0; i < packet->size; i++)
+        check ^= packet->bytes[i];
+
+    packet->end = end;
+    packet->valid = (packet->size >= 3 && check == 0);
+
+    dec->stats.packets++;
+    if(!packet->valid)
+        dec->stats.bad_checksums++;
+
+    if(dec->on_packet != NULL)
+        dec->on_packet(dec->ctx, packet);
+}
@@ -0,0 +1,179 @@
+/**
+ * @file dccdec.h
+ * @brief Defines a streaming DCC signal decoder.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The decoder is fed the edges of a track signal, or the durations of its
+ * halves, and frames them into packets as a decoder on the track would,
+ * following NMRA S-9.1 and S-9.2:
+ *
+ * - A half of a one bit lasts 52 to 64us, and both halves of a one bit
+ *   may differ by no more than 6us.
+ * - A half of a zero bit lasts 90 to 10000us.
+ * - A packet is a preamble of ones, a zero packet start bit, then data
+ *   bytes each followed by a zero, ending with a one packet end bit. The
+ *   last data byte is the exclusive or of the others.
+ *
+ * Halves outside both windows, and bits whose halves differ in kind, are
+ * reported as errors and the decoder looks for the next preamble. The
+ * decoder keeps no history beyond the packet it is framing.
+ *
+ * Edges may be fed one at a time, or in blocks, where the half bits of a
+ * block are classified together before framing. The block classifier
+ * uses SSE2 where the host has it, and a branch free loop the compiler
+ * can vectorise elsewhere.
+ */
+
+#ifndef DCCDEC_DEFINED
+#define DCCDEC_DEFINED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define T                       Dccdec_T
+
+#define DCCDEC_ONE_MIN          52000   /**< Shortest half of a one bit, in ns. */
+#define DCCDEC_ONE_MAX          64000
+#define DCCDEC_ONE_SKEW         6000    /**< Largest difference between the halves of a one. */
+#define DCCDEC_ZERO_MIN         90000   /**< Shortest half of a zero bit, in ns. */
+#define DCCDEC_ZERO_MAX         10000000
+
+#define DCCDEC_MIN_PREAMBLE     10      /**< Fewest preamble bits a decoder must accept. */
+#define DCCDEC_MAX_BYTES        16      /**< Longest packet framed, including the checksum. */
+#define DCCDEC_BLOCK            1024    /**< Halves classified at a time by Dccdec_edges(). */
+
+/*
+ * Errors reported by the decoder.
+ */
+#define DCCDEC_ERR_HALF         0   /**< A half bit outside both windows. */
+#define DCCDEC_ERR_SKEW         1   /**< The halves of a one differ too much. */
+#define DCCDEC_ERR_MIXED        2   /**< The halves of a bit differ in kind. */
+#define DCCDEC_ERR_PREAMBLE     3   /**< Too few preamble bits to frame a packet. */
+#define DCCDEC_ERR_LONG         4   /**< A packet longer than DCCDEC_MAX_BYTES. */
+#define DCCDEC_NUM_ERRS         5
+
+/*
+ * Decoder address keys, see Dccdec_address().
+ */
+#define DCCDEC_ADDR_NONE        -1      /**< Idle and reserved packets. */
+#define DCCDEC_ADDR_LONG        128     /**< Offset of the long multi-function addresses. */
+#define DCCDEC_ADDR_ACCESSORY   (DCCDEC_ADDR_LONG + 10240)
+#define DCCDEC_NUM_ADDRS        (DCCDEC_ADDR_ACCESSORY + 512)
+
+/** Classify a half bit duration in ns as 1, 0, or -1 for neither. */
+#define DCCDEC_CLASSIFY(ns) \
+    (((ns) >= DCCDEC_ONE_MIN && (ns) <= DCCDEC_ONE_MAX) ? 1 \
+        : (((ns) >= DCCDEC_ZERO_MIN && (ns) <= DCCDEC_ZERO_MAX) ? 0 : -1))
+
+/**
+ * A framed packet.
+ */
+struct Dccdec_packet
+{
+    uint64_t start;         /**< The start of the packet start bit, in ns. */
+    uint64_t end;           /**< The end of the packet end bit, in ns. */
+    unsigned preamble;      /**< The preamble bits ahead of the start bit. */
+    int size;
+    int valid;              /**< Non-zero if the checksum matches. */
+    uint8_t bytes[DCCDEC_MAX_BYTES];
+};
+
+typedef void (*Dccdec_packet_fn)(void *ctx, const struct Dccdec_packet *packet);
+typedef void (*Dccdec_error_fn)(void *ctx, int err, uint64_t time);
+
+/**
+ * Counters kept by the decoder. Durations are in ns.
+ */
+struct Dccdec_stats
+{
+    uint64_t halves;
+    uint64_t ones;
+    uint64_t zeros;
+    uint64_t packets;
+    uint64_t bad_checksums;
+    uint64_t errors[DCCDEC_NUM_ERRS];
+    uint32_t one_min, one_max;
+    uint32_t zero_min, zero_max;
+};
+
+typedef struct T *T;
+struct T
+{
+    Dccdec_packet_fn on_packet;
+    Dccdec_error_fn on_error;
+    void *ctx;
+    struct Dccdec_stats stats;
+
+    /* Framing state. */
+    int state;
+    int started;            /**< Non-zero once the first edge is seen. */
+    uint64_t edge;          /**< The time of the last edge. */
+    unsigned shorts;        /**< Consecutive one halves seen in the preamble. */
+    int first;              /**< The kind of the first half of a data bit. */
+    uint32_t first_ns;
+    int bits;               /**< Bits of the current byte, then its separator. */
+    uint8_t byte;
+    struct Dccdec_packet packet;
+};
+
+/**
+ * Initialise a decoder.
+ *
+ * @param dec The decoder.
+ * @param on_packet Called with each framed packet, valid or not.
+ * @param on_error Called with each error, or NULL.
+ * @param ctx Passed to both callbacks.
+ */
+extern void Dccdec_init(T dec, Dccdec_packet_fn on_packet, Dccdec_error_fn on_error,
+                        void *ctx);
+
+/**
+ * Feed the decoder an edge of the signal, at the given time in ns.
+ */
+extern void Dccdec_edge(T dec, uint64_t time);
+
+/**
+ * Feed the decoder a block of edges, at the given times in ns. This gives
+ * the same packets and errors as feeding each with Dccdec_edge().
+ */
+extern void Dccdec_edges(T dec, const uint64_t *times, size_t n);
+
+/**
+ * Feed the decoder a half bit, starting at the given time and lasting the
+ * given duration, both in ns.
+ */
+extern void Dccdec_half(T dec, uint64_t start, uint32_t ns);
+
+/**
+ * Classify a block of half bit durations in ns, as DCCDEC_CLASSIFY().
+ */
+extern void Dccdec_classify(const uint32_t *ns, int8_t *kind, size_t n);
+
+/**
+ * Decode a baseline speed and direction instruction, 01DCSSSS, as a
+ * decoder in 28 step mode would.
+ *
+ * @param instruction The instruction byte.
+ * @param direction Set to DCC_DIRECTION_FORWARD or DCC_DIRECTION_REVERSE.
+ *
+ * @return The speed step, 0 to 28, with the emergency stops as 0, or -1 if
+ *  the byte is not a speed and direction instruction.
+ */
+extern int Dccdec_speed(uint8_t instruction, int *direction);
+
+/**
+ * Return a key for the decoder a packet is addressed to, below
+ * DCCDEC_NUM_ADDRS. Short addresses, and 0 for broadcast, are their own
+ * key; long and accessory addresses are offset by DCCDEC_ADDR_LONG and
+ * DCCDEC_ADDR_ACCESSORY. Idle and reserved packets give DCCDEC_ADDR_NONE.
+ */
+extern int Dccdec_address(const struct Dccdec_packet *packet);
+
+/**
+ * Return the name of an error.
+ */
+extern const char *Dccdec_error_name(int err);
+
+#undef T
+#endif
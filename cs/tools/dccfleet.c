@@ -0,0 +1,584 @@
+/**
+ * @file dccfleet.c
+ * @brief Models a fleet of mobile decoders on a captured track signal.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This host program answers whether the scheduler and refresh cache can
+ * serve a roster of a given size. It reads a value change dump written by
+ * the native build with -w, which holds both the track signal and every
+ * character the command station received, and models a mobile decoder
+ * for each loco address the commands name:
+ *
+ * - each decoder follows the speed and direction packets addressed to it,
+ *   and the broadcast stop, as a decoder on the track would,
+ * - the update latency is the time from the end of a command line to the
+ *   end of the first packet which gives the decoder its new state,
+ * - the refresh gap is the time between the end of one packet to the
+ *   decoder and the start of the next,
+ * - a timeout is a gap longer than the decoder's packet timeout, when a
+ *   decoder with a timeout set would stop the loco, including the gap
+ *   from its last packet to the end of the capture.
+ *
+ * It reports these over the fleet and for each decoder, and exits with 1
+ * if any decoder timed out or any update never reached the track.
+ *
+ * With -g it instead writes a throttle script for the native build: a
+ * fleet of n decoders at addresses 1 to n, each sent c speed changes in
+ * a random order, optionally paced with blank lines, eg:
+ *
+ * @code
+ * dccfleet -g -N 60 -c 5 -i 50 > fleet.dsl
+ * ../cs-native -s 0 -l 3000 -w fleet.vcd < fleet.dsl > /dev/null
+ * dccfleet -T 1000 fleet.vcd
+ * @endcode
+ *
+ * The commands are sent in machine mode, as a host program would, since
+ * in human mode the echo is slower than the input at full line rate. Only
+ * the loco commands of the DSL are modelled, and only short addresses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "vcd.h"
+#include "dccdec.h"
+#include "../dcc.h"
+
+#define FLEET_TIMEOUT_MS    1000    /**< Default decoder packet timeout. */
+#define FLEET_MAX_LINE      128
+#define FLEET_ANY           -1      /**< Any direction satisfies the update. */
+#define FLEET_FRAME_BITS    10      /**< Start bit, 8 data bits and a stop bit. */
+
+/**
+ * A modelled mobile decoder.
+ */
+struct Fleet_decoder
+{
+    int active;             /**< Non-zero once a command has named it. */
+    uint64_t since;         /**< When the first command named it, in ns. */
+    uint64_t timeout;       /**< Packet timeout, in ns. */
+
+    /* The state last received from the track, step -1 if none yet. */
+    int step;
+    int direction;
+
+    /* The update waiting to reach the track, if any. */
+    int pending;
+    int want_step;
+    int want_direction;
+    uint64_t issued;        /**< End of the command line, in ns. */
+
+    uint64_t packets;
+    uint64_t last;          /**< End of the last packet, or 0. */
+    uint64_t gaps, gap_sum, gap_max;
+    uint64_t timeouts;
+    uint64_t updates, superseded;
+    uint64_t latency_sum, latency_max;
+};
+
+struct Fleet
+{
+    int dump;
+    uint64_t timeout;       /**< In ns. */
+    struct Fleet_decoder decoders[DCC_ADDRESS_MAX];
+
+    /* The command line being received. */
+    char line[FLEET_MAX_LINE];
+    int line_len;
+
+    uint64_t commands;
+    uint64_t ignored;       /**< Lines not modelled. */
+    uint64_t other;         /**< Packets not modelled. */
+
+    /* Every latency, for the percentiles. */
+    uint64_t *latencies;
+    size_t num_latencies, max_latencies;
+};
+
+static void Fleet_packet(void *ctx, const struct Dccdec_packet *packet);
+static void Fleet_rx(struct Fleet *fleet, int c, uint64_t time);
+static void Fleet_command(struct Fleet *fleet, char *line, uint64_t time);
+static void Fleet_want(struct Fleet *fleet, int address, int step, int direction,
+                       uint64_t time);
+static void Fleet_state(struct Fleet *fleet, int address, int step, int direction,
+                        uint64_t time);
+static void Fleet_gap(struct Fleet *fleet, int address, uint64_t gap, uint64_t time);
+static int Fleet_compare(const void *a, const void *b);
+static int Fleet_generate(int decoders, int changes, int interval, uint32_t seed);
+static void Fleet_usage(void);
+
+static struct Fleet Fleet;
+
+int
+main(int argc, char **argv)
+{
+    struct Vcd_T vcd;
+    struct Dccdec_T dec;
+    struct Fleet_decoder *d;
+    const char *name = NULL, *bus = "rx";
+    uint64_t time = 0, first = 0, gap_sum = 0, gaps = 0, gap_max = 0, timeouts = 0,
+             superseded = 0, unsatisfied = 0, sum = 0;
+    int generate = 0, decoders = 10, changes = 5, interval = 0, active = 0, c, value, i;
+    uint32_t seed = 1;
+    FILE *in = stdin;
+    size_t n;
+
+    Fleet.timeout = FLEET_TIMEOUT_MS * 1000000ULL;
+
+    while((c = getopt(argc, argv, "dn:r:T:gN:c:i:s:")) != -1)
+    {
+        switch(c)
+        {
+            case 'd':
+                Fleet.dump = 1;
+                break;
+
+            case 'n':
+                name = optarg;
+                break;
+
+            case 'r':
+                bus = optarg;
+                break;
+
+            case 'T':
+                Fleet.timeout = strtoull(optarg, NULL, 10) * 1000000ULL;
+                break;
+
+            case 'g':
+                generate = 1;
+                break;
+
+            case 'N':
+                decoders = atoi(optarg);
+                break;
+
+            case 'c':
+                changes = atoi(optarg);
+                break;
+
+            case 'i':
+                interval = atoi(optarg);
+                break;
+
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+
+            default:
+                Fleet_usage();
+                return 2;
+        }
+    }
+
+    if(generate)
+    {
+        if(decoders < 1 || decoders >= DCC_ADDRESS_MAX || changes < 1 || interval < 0)
+        {
+            Fleet_usage();
+            return 2;
+        }
+
+        return Fleet_generate(decoders, changes, interval, seed);
+    }
+
+    if(optind < argc && (in = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    if(Vcd_open_bus(&vcd, in, name, bus) < 0)
+    {
+        fprintf(stderr, "dccfleet: no %s signal or %s vector in the dump\n",
+            (name ? name : "one bit"), bus);
+        return 2;
+    }
+
+    for(i=0; i < DCC_ADDRESS_MAX; i++)
+    {
+        Fleet.decoders[i].timeout = Fleet.timeout;
+        Fleet.decoders[i].step = -1;
+    }
+
+    Dccdec_init(&dec, Fleet_packet, NULL, &Fleet);
+    while((c = Vcd_next_edge(&vcd, &time, &value)) != VCD_END)
+    {
+        if(c == VCD_BUS)
+        {
+            Fleet_rx(&Fleet, value, time);
+            continue;
+        }
+
+        if(!dec.started)
+            first = time;
+        Dccdec_edge(&dec, time);
+    }
+
+    /* Fleet totals, closing each decoder's last gap at the end. */
+    for(i=1; i < DCC_ADDRESS_MAX; i++)
+    {
+        d = &Fleet.decoders[i];
+        if(!d->active)
+            continue;
+
+        if(time - (d->last > 0 ? d->last : d->since) > d->timeout)
+            Fleet_gap(&Fleet, i, time - (d->last > 0 ? d->last : d->since), time);
+
+        active++;
+        gaps += d->gaps;
+        gap_sum += d->gap_sum;
+        if(d->gap_max > gap_max)
+            gap_max = d->gap_max;
+        timeouts += d->timeouts;
+        superseded += d->superseded;
+        unsatisfied += d->pending;
+    }
+
+    printf("signal:       %.3f s, %" PRIu64 " packets, %" PRIu64 " bad checksums, "
+        "%" PRIu64 " not modelled\n", (time - first) / 1e9, dec.stats.packets,
+        dec.stats.bad_checksums, Fleet.other);
+    printf("commands:     %" PRIu64 " to %d decoders, %" PRIu64 " lines not modelled\n",
+        Fleet.commands, active, Fleet.ignored);
+    printf("timeout:      %.0f ms\n", Fleet.timeout / 1e6);
+
+    if((n = Fleet.num_latencies) > 0)
+    {
+        qsort(Fleet.latencies, n, sizeof(Fleet.latencies[0]), Fleet_compare);
+        for(i=0; i < n; i++)
+            sum += Fleet.latencies[i];
+
+        printf("latency:      %.3f min, %.3f mean, %.3f p50, %.3f p95, %.3f max ms\n",
+            Fleet.latencies[0] / 1e6, sum / 1e6 / n, Fleet.latencies[n / 2] / 1e6,
+            Fleet.latencies[(n * 95) / 100] / 1e6, Fleet.latencies[n - 1] / 1e6);
+    }
+    if(gaps > 0)
+    {
+        printf("refresh gap:  %.3f mean, %.3f max ms\n", gap_sum / 1e6 / gaps, gap_max / 1e6);
+    }
+    printf("updates:      %zu reached the track, %" PRIu64 " superseded, %" PRIu64 " lost\n",
+        n, superseded, unsatisfied);
+    printf("timeouts:     %" PRIu64 "\n", timeouts);
+
+    printf("\n addr  packets  updates   lat mean    lat max   gap mean    gap max  timeouts  state\n");
+    for(i=1; i < DCC_ADDRESS_MAX; i++)
+    {
+        d = &Fleet.decoders[i];
+        if(!d->active)
+            continue;
+
+        printf("%5d %8" PRIu64 " %8" PRIu64 " %10.3f %10.3f %10.3f %10.3f %9" PRIu64,
+            i, d->packets, d->updates,
+            (d->updates > 0 ? d->latency_sum / 1e6 / d->updates : 0),
+            d->latency_max / 1e6, (d->gaps > 0 ? d->gap_sum / 1e6 / d->gaps : 0),
+            d->gap_max / 1e6, d->timeouts);
+
+        if(d->step < 0)
+            printf("  -\n");
+        else
+            printf("  %c %d%s\n", (d->direction == DCC_DIRECTION_FORWARD ? 'F' : 'R'),
+                d->step, (d->pending ? " lost" : ""));
+    }
+
+    printf("\nresult:       %s\n", (timeouts > 0 || unsatisfied > 0 ? "FAIL" : "ok"));
+
+    free(Fleet.latencies);
+
+    return (timeouts > 0 || unsatisfied > 0);
+}
+
+static void
+Fleet_packet(void *ctx, const struct Dccdec_packet *packet)
+{
+    struct Fleet *fleet = ctx;
+    int address, step, direction, i;
+
+    address = Dccdec_address(packet);
+
+    /* Only baseline speed and direction packets are modelled. */
+    if(!packet->valid || packet->size != 3 || address < 0 || address >= DCC_ADDRESS_MAX
+        || (step = Dccdec_speed(packet->bytes[1], &direction)) < 0)
+    {
+        fleet->other++;
+        return;
+    }
+
+    if(address == 0)
+    {
+        /* A broadcast reaches every decoder. */
+        for(i=1; i < DCC_ADDRESS_MAX; i++)
+        {
+            if(fleet->decoders[i].active)
+                Fleet_state(fleet, i, step, direction, packet->end);
+        }
+        return;
+    }
+
+    Fleet_state(fleet, address, step, direction, packet->end);
+
+    /* Gaps are measured between packets, so from this one's start. */
+    if(fleet->decoders[address].last > 0)
+    {
+        Fleet_gap(fleet, address, packet->start - fleet->decoders[address].last,
+            packet->start);
+    }
+
+    fleet->decoders[address].packets++;
+    fleet->decoders[address].last = packet->end;
+}
+
+/**
+ * Take a received character, modelling each complete line.
+ */
+static void
+Fleet_rx(struct Fleet *fleet, int c, uint64_t time)
+{
+    if(c != '\n' && c != ';')
+    {
+        if(fleet->line_len < (FLEET_MAX_LINE - 1))
+            fleet->line[fleet->line_len++] = tolower(c);
+        return;
+    }
+
+    fleet->line[fleet->line_len] = '\0';
+    fleet->line_len = 0;
+
+    if(strspn(fleet->line, " \t\r") != strlen(fleet->line))
+        Fleet_command(fleet, fleet->line, time);
+}
+
+/**
+ * Model a command line: forward or reverse with an address and speed in
+ * either order, stop with an address, or stop all.
+ */
+static void
+Fleet_command(struct Fleet *fleet, char *line, uint64_t time)
+{
+    const char *sep = " \t\r";
+    char *verb, *word, *arg;
+    int address = -1, step = -1, direction, i;
+
+    if((verb = strtok(line, sep)) != NULL && verb[0] == '#')
+        verb = strtok(NULL, sep);
+
+    if(verb == NULL || (strcmp(verb, "forward") != 0 && strcmp(verb, "reverse") != 0
+        && strcmp(verb, "stop") != 0))
+    {
+        fleet->ignored++;
+        return;
+    }
+
+    direction = (verb[0] == 'f' ? DCC_DIRECTION_FORWARD
+        : (verb[0] == 'r' ? DCC_DIRECTION_REVERSE : FLEET_ANY));
+
+    while((word = strtok(NULL, sep)) != NULL)
+    {
+        if(strcmp(word, "all") == 0 && direction == FLEET_ANY)
+            continue;
+
+        if((arg = strtok(NULL, sep)) == NULL || !isdigit((unsigned char) arg[0]))
+        {
+            fleet->ignored++;
+            return;
+        }
+
+        if(strcmp(word, "addr") == 0)
+            address = atoi(arg);
+        else if(strcmp(word, "speed") == 0)
+            step = atoi(arg) % DCC_MAX_SPEED_STEPS;
+    }
+
+    if(direction == FLEET_ANY)
+        step = 0;
+
+    if(step < 0 || address == 0 || address >= DCC_ADDRESS_MAX
+        || (address < 0 && direction != FLEET_ANY))
+    {
+        fleet->ignored++;
+        return;
+    }
+
+    fleet->commands++;
+
+    if(address > 0)
+    {
+        Fleet_want(fleet, address, step, direction, time);
+        return;
+    }
+
+    /* Stop all. */
+    for(i=1; i < DCC_ADDRESS_MAX; i++)
+    {
+        if(fleet->decoders[i].active)
+            Fleet_want(fleet, i, 0, FLEET_ANY, time);
+    }
+}
+
+static void
+Fleet_want(struct Fleet *fleet, int address, int step, int direction, uint64_t time)
+{
+    struct Fleet_decoder *d = &fleet->decoders[address];
+
+    if(d->pending)
+        d->superseded++;
+
+    if(!d->active)
+        d->since = time;
+
+    d->active = 1;
+    d->pending = 1;
+    d->want_step = step;
+    d->want_direction = direction;
+    d->issued = time;
+
+    if(fleet->dump)
+    {
+        printf("%12.6f ms  addr %d wants %d %s\n", time / 1e6, address, step,
+            (direction == FLEET_ANY ? "" : (direction == DCC_DIRECTION_FORWARD ? "F" : "R")));
+    }
+}
+
+/**
+ * Update a decoder's state from the track, completing any update it
+ * satisfies.
+ */
+static void
+Fleet_state(struct Fleet *fleet, int address, int step, int direction, uint64_t time)
+{
+    struct Fleet_decoder *d = &fleet->decoders[address];
+    uint64_t latency;
+
+    d->step = step;
+    d->direction = direction;
+
+    if(!d->pending || step != d->want_step
+        || (d->want_direction != FLEET_ANY && direction != d->want_direction))
+    {
+        return;
+    }
+
+    latency = time - d->issued;
+    d->pending = 0;
+    d->updates++;
+    d->latency_sum += latency;
+    if(latency > d->latency_max)
+        d->latency_max = latency;
+
+    if(fleet->num_latencies == fleet->max_latencies)
+    {
+        fleet->max_latencies = (fleet->max_latencies ? fleet->max_latencies * 2 : 1024);
+        if((fleet->latencies = realloc(fleet->latencies,
+            fleet->max_latencies * sizeof(fleet->latencies[0]))) == NULL)
+        {
+            perror("dccfleet");
+            exit(2);
+        }
+    }
+    fleet->latencies[fleet->num_latencies++] = latency;
+
+    if(fleet->dump)
+        printf("%12.6f ms  addr %d updated in %.3f ms\n", time / 1e6, address, latency / 1e6);
+}
+
+static void
+Fleet_gap(struct Fleet *fleet, int address, uint64_t gap, uint64_t time)
+{
+    struct Fleet_decoder *d = &fleet->decoders[address];
+
+    /* Gaps only count once the decoder is in service. */
+    if(!d->active)
+        return;
+
+    d->gaps++;
+    d->gap_sum += gap;
+    if(gap > d->gap_max)
+        d->gap_max = gap;
+
+    if(gap > d->timeout)
+    {
+        d->timeouts++;
+        if(fleet->dump)
+            printf("%12.6f ms  addr %d timed out, %.3f ms gap\n", time / 1e6, address, gap / 1e6);
+    }
+}
+
+static int
+Fleet_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Write a throttle script, pacing the commands with blank lines, each
+ * taking a character's time on the serial line.
+ */
+static int
+Fleet_generate(int decoders, int changes, int interval, uint32_t seed)
+{
+    int left[DCC_ADDRESS_MAX], step[DCC_ADDRESS_MAX], total = decoders * changes,
+        pad = ((long) interval * CONFIG_BAUD_RATE) / (FLEET_FRAME_BITS * 1000), seq, i, s;
+
+    for(i=1; i <= decoders; i++)
+    {
+        left[i] = changes;
+        step[i] = 0;
+    }
+
+    seed = (seed ? seed : 1);
+    printf("mode machine\n");
+
+    for(seq=1; seq <= total; seq++)
+    {
+        /* Xorshift, so a seed repeats a script exactly. */
+        do
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            i = 1 + (seed % decoders);
+        }
+        while(left[i] == 0);
+
+        /* Each change is to a new step, so the update can be seen. */
+        do
+        {
+            s = 1 + ((seed >> 8) % (DCC_MAX_SPEED_STEPS - 1));
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+        }
+        while(s == step[i]);
+
+        left[i]--;
+        step[i] = s;
+        printf("#%d %s addr %d speed %d\n", seq, ((seed >> 4) & 1 ? "forward" : "reverse"), i, s);
+
+        for(s=0; s < pad; s++)
+            putchar('\n');
+    }
+
+    return 0;
+}
+
+static void
+Fleet_usage(void)
+{
+    fprintf(stderr, "usage: dccfleet [-d] [-n name] [-r name] [-T ms] [file]\n");
+    fprintf(stderr, "       dccfleet -g [-N decoders] [-c changes] [-i ms] [-s seed]\n");
+    fprintf(stderr, "  -d        print every command, update and timeout\n");
+    fprintf(stderr, "  -n name   the track signal (default the first one bit signal)\n");
+    fprintf(stderr, "  -r name   the received characters (default rx)\n");
+    fprintf(stderr, "  -T ms     decoder packet timeout (default %d)\n", FLEET_TIMEOUT_MS);
+    fprintf(stderr, "  -g        write a throttle script instead\n");
+    fprintf(stderr, "  -N n      decoders in the script, at addresses 1 to n (default 10)\n");
+    fprintf(stderr, "  -c n      speed changes per decoder (default 5)\n");
+    fprintf(stderr, "  -i ms     time between commands (default 0, at the line rate)\n");
+    fprintf(stderr, "  -s seed   seed the script (default 1)\n");
+}
@@ -0,0 +1,410 @@
+/**
+ * @file dccsniff.c
+ * @brief Decodes the DCC packets in a captured track signal.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * This host program is a sniffer for debugging: it reads the edges of a
+ * track signal, decodes the packets with the streaming decoder and
+ * reports each packet's address, instruction and checksum, the protocol
+ * errors found, and statistics for each address seen.
+ *
+ * The capture is read in blocks of edges, whose half bits are classified
+ * together (see Dccdec_edges()), so a capture of any length is decoded in
+ * constant memory. It may be:
+ *
+ * - a value change dump, such as one written by the native build with -w
+ *   or exported from a logic analyser, or
+ * - raw edges, the time of each edge in ns as a little endian 64 bit
+ *   integer, which is far quicker to read for long captures. A dump is
+ *   converted to raw edges with -o.
+ *
+ * @code
+ * dccsniff [-r] [-n name] [-d] [-e] [-q] [-o file] [file]
+ * @endcode
+ *
+ * -r reads raw edges, -n selects the signal of a dump by name (the first
+ * one bit signal by default), -d prints every packet and -e every error,
+ * -q omits the table of addresses. The capture is read from stdin if no
+ * file is given.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <endian.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vcd.h"
+#include "dccdec.h"
+#include "../dcc.h"
+
+#define SNIFF_BLOCK     65536   /**< Edges read at a time. */
+#define SNIFF_DESC_LEN  48
+
+/**
+ * What is known of each address, indexed by the key from Dccdec_address().
+ */
+struct Sniff_addr
+{
+    uint64_t packets;
+    uint64_t last;          /**< End of the last packet, or 0. */
+    uint64_t gaps, gap_sum, gap_min;
+    uint8_t size;           /**< The last packet. */
+    uint8_t bytes[DCCDEC_MAX_BYTES];
+};
+
+struct Sniff
+{
+    int dump;
+    int errors;
+    uint64_t idle;
+    uint64_t unaddressed;   /**< Valid packets to no decoder, other than idle. */
+    struct Sniff_addr addrs[DCCDEC_NUM_ADDRS];
+};
+
+static void Sniff_packet(void *ctx, const struct Dccdec_packet *packet);
+static void Sniff_error(void *ctx, int err, uint64_t time);
+static void Sniff_describe(const uint8_t *bytes, int size, char *desc);
+static void Sniff_address(int key, char *name);
+static double Sniff_now(void);
+static void Sniff_usage(void);
+
+static struct Sniff Sniff;
+static uint64_t Sniff_edges[SNIFF_BLOCK];
+
+int
+main(int argc, char **argv)
+{
+    struct Vcd_T vcd;
+    struct Dccdec_T dec;
+    struct Dccdec_stats *stats = &dec.stats;
+    struct Sniff_addr *a;
+    const char *name = NULL, *out_name = NULL;
+    char desc[SNIFF_DESC_LEN], addr[16];
+    uint64_t first = 0, last = 0, edges = 0;
+    int raw = 0, quiet = 0, c, value, i;
+    FILE *in = stdin, *out = NULL;
+    double start, secs;
+    size_t n, j;
+
+    while((c = getopt(argc, argv, "rn:deqo:")) != -1)
+    {
+        switch(c)
+        {
+            case 'r':
+                raw = 1;
+                break;
+
+            case 'n':
+                name = optarg;
+                break;
+
+            case 'd':
+                Sniff.dump = 1;
+                break;
+
+            case 'e':
+                Sniff.errors = 1;
+                break;
+
+            case 'q':
+                quiet = 1;
+                break;
+
+            case 'o':
+                out_name = optarg;
+                break;
+
+            default:
+                Sniff_usage();
+                return 2;
+        }
+    }
+
+    if(optind < argc && (in = fopen(argv[optind], "rb")) == NULL)
+    {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    if(out_name != NULL && (out = fopen(out_name, "wb")) == NULL)
+    {
+        perror(out_name);
+        return 2;
+    }
+
+    if(!raw && Vcd_open(&vcd, in, name) < 0)
+    {
+        fprintf(stderr, "dccsniff: no %s signal in the dump\n", (name ? name : "one bit"));
+        return 2;
+    }
+
+    Dccdec_init(&dec, Sniff_packet, Sniff_error, &Sniff);
+
+    start = Sniff_now();
+    for(;;)
+    {
+        if(raw)
+        {
+            n = fread(Sniff_edges, sizeof(Sniff_edges[0]), SNIFF_BLOCK, in);
+            for(j=0; j < n; j++)
+                Sniff_edges[j] = le64toh(Sniff_edges[j]);
+        }
+        else
+        {
+            for(n=0; n < SNIFF_BLOCK && Vcd_next_edge(&vcd, &Sniff_edges[n], &value); n++)
+                ;
+        }
+
+        if(n == 0)
+            break;
+
+        if(edges == 0)
+            first = Sniff_edges[0];
+        last = Sniff_edges[n - 1];
+        edges += n;
+
+        if(out != NULL)
+        {
+            for(j=0; j < n; j++)
+                Sniff_edges[j] = htole64(Sniff_edges[j]);
+            fwrite(Sniff_edges, sizeof(Sniff_edges[0]), n, out);
+            for(j=0; j < n; j++)
+                Sniff_edges[j] = le64toh(Sniff_edges[j]);
+        }
+
+        Dccdec_edges(&dec, Sniff_edges, n);
+    }
+    secs = Sniff_now() - start;
+
+    if(out != NULL && fclose(out) != 0)
+    {
+        perror(out_name);
+        return 2;
+    }
+
+    printf("signal:       %.3f s, %" PRIu64 " edges, %" PRIu64 " ones, %" PRIu64 " zeros\n",
+        (last - first) / 1e9, edges, stats->ones, stats->zeros);
+    printf("packets:      %" PRIu64 " framed, %" PRIu64 " idle, %" PRIu64 " unaddressed, "
+        "%" PRIu64 " bad checksums\n", stats->packets, Sniff.idle, Sniff.unaddressed,
+        stats->bad_checksums);
+    for(i=0; i < DCCDEC_NUM_ERRS; i++)
+    {
+        if(stats->errors[i] > 0)
+            printf("error:        %s, %" PRIu64 "\n", Dccdec_error_name(i), stats->errors[i]);
+    }
+    if(secs > 0)
+    {
+        printf("decoded:      %.1f Medges/s, %.1f MB/s of edges\n", edges / secs / 1e6,
+            edges * sizeof(Sniff_edges[0]) / secs / 1e6);
+    }
+
+    if(quiet)
+        return 0;
+
+    printf("\n%-8s %10s %12s %12s  %s\n", "addr", "packets", "gap min ms", "gap mean ms",
+        "last instruction");
+    for(i=0; i < DCCDEC_NUM_ADDRS; i++)
+    {
+        a = &Sniff.addrs[i];
+        if(a->packets == 0)
+            continue;
+
+        Sniff_address(i, addr);
+        Sniff_describe(a->bytes, a->size, desc);
+        printf("%-8s %10" PRIu64, addr, a->packets);
+        if(a->gaps > 0)
+            printf(" %12.3f %12.3f", a->gap_min / 1e6, a->gap_sum / 1e6 / a->gaps);
+        else
+            printf(" %12s %12s", "-", "-");
+        printf("  %s\n", desc);
+    }
+
+    return 0;
+}
+
+static void
+Sniff_packet(void *ctx, const struct Dccdec_packet *packet)
+{
+    struct Sniff *sniff = ctx;
+    struct Sniff_addr *a;
+    char desc[SNIFF_DESC_LEN], addr[16];
+    int key, i;
+
+    key = Dccdec_address(packet);
+
+    if(sniff->dump)
+    {
+        Sniff_address(key, addr);
+        Sniff_describe(packet->bytes, packet->size, desc);
+        printf("%14.6f ms  %-8s %-24s", packet->start / 1e6, addr, desc);
+        for(i=0; i < packet->size; i++)
+            printf(" %02x", packet->bytes[i]);
+        printf("%s\n", (packet->valid ? "" : "  bad checksum"));
+    }
+
+    if(!packet->valid)
+        return;
+
+    if(key == DCCDEC_ADDR_NONE)
+    {
+        if(packet->bytes[0] == 0xFF)
+            sniff->idle++;
+        else
+            sniff->unaddressed++;
+        return;
+    }
+
+    a = &sniff->addrs[key];
+    if(a->last > 0)
+    {
+        if(a->gaps == 0 || (packet->start - a->last) < a->gap_min)
+            a->gap_min = packet->start - a->last;
+        a->gap_sum += packet->start - a->last;
+        a->gaps++;
+    }
+
+    a->packets++;
+    a->last = packet->end;
+    a->size = packet->size;
+    memcpy(a->bytes, packet->bytes, packet->size);
+}
+
+static void
+Sniff_error(void *ctx, int err, uint64_t time)
+{
+    struct Sniff *sniff = ctx;
+
+    if(sniff->errors)
+        printf("%14.6f ms  %s\n", time / 1e6, Dccdec_error_name(err));
+}
+
+/**
+ * Describe the instruction of a packet, following NMRA S-9.2 and S-9.2.1.
+ */
+static void
+Sniff_describe(const uint8_t *bytes, int size, char *desc)
+{
+    const uint8_t *in = bytes + 1;
+    int direction, step;
+
+    if(size < 3)
+    {
+        strcpy(desc, "runt");
+        return;
+    }
+
+    if(bytes[0] == 0xFF)
+    {
+        strcpy(desc, "idle");
+        return;
+    }
+
+    if(bytes[0] >= 128 && bytes[0] < 192)
+    {
+        /* Basic accessory, 10AAAAAA 1AAACDDD. */
+        snprintf(desc, SNIFF_DESC_LEN, "accessory output %d %s", bytes[1] & 0x07,
+            ((bytes[1] & 0x08) ? "on" : "off"));
+        return;
+    }
+
+    /* Long addresses take two bytes. */
+    if(bytes[0] >= 192 && bytes[0] < 232)
+        in++;
+
+    if((in - bytes) >= size - 1)
+    {
+        strcpy(desc, "runt");
+        return;
+    }
+
+    if(bytes[0] == 0 && in[0] == 0)
+    {
+        strcpy(desc, "reset");
+        return;
+    }
+
+    if((step = Dccdec_speed(in[0], &direction)) >= 0)
+    {
+        snprintf(desc, SNIFF_DESC_LEN, "speed %c %d", (direction == DCC_DIRECTION_FORWARD
+            ? 'F' : 'R'), step);
+        return;
+    }
+
+    switch(in[0] >> 5)
+    {
+        case 0:
+            if(in[0] == 0x3F && (in + 1 - bytes) < size - 1)
+            {
+                snprintf(desc, SNIFF_DESC_LEN, "speed128 %c %d",
+                    ((in[1] & 0x80) ? 'F' : 'R'), in[1] & 0x7F);
+            }
+            else
+            {
+                snprintf(desc, SNIFF_DESC_LEN, "control 0x%02x", in[0]);
+            }
+            break;
+
+        case 4:
+            snprintf(desc, SNIFF_DESC_LEN, "functions FL-F4 0x%02x", in[0] & 0x1F);
+            break;
+
+        case 5:
+            snprintf(desc, SNIFF_DESC_LEN, "functions %s 0x%02x",
+                ((in[0] & 0x10) ? "F5-F8" : "F9-F12"), in[0] & 0x0F);
+            break;
+
+        case 7:
+            strcpy(desc, "cv access");
+            break;
+
+        default:
+            snprintf(desc, SNIFF_DESC_LEN, "instruction 0x%02x", in[0]);
+            break;
+    }
+}
+
+/**
+ * Name an address key: short, broadcast, long (L) or accessory (A).
+ */
+static void
+Sniff_address(int key, char *name)
+{
+    if(key == DCCDEC_ADDR_NONE)
+        strcpy(name, "-");
+    else if(key == 0)
+        strcpy(name, "all");
+    else if(key < DCCDEC_ADDR_LONG)
+        sprintf(name, "%d", key);
+    else if(key < DCCDEC_ADDR_ACCESSORY)
+        sprintf(name, "L%d", key - DCCDEC_ADDR_LONG);
+    else
+        sprintf(name, "A%d", key - DCCDEC_ADDR_ACCESSORY);
+}
+
+static double
+Sniff_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void
+Sniff_usage(void)
+{
+    fprintf(stderr, "usage: dccsniff [-r] [-n name] [-d] [-e] [-q] [-o file] [file]\n");
+    fprintf(stderr, "  -r        read raw edges, 64 bit little endian ns, not a dump\n");
+    fprintf(stderr, "  -n name   the signal to decode (default the first one bit signal)\n");
+    fprintf(stderr, "  -d        print every packet\n");
+    fprintf(stderr, "  -e        print every error\n");
+    fprintf(stderr, "  -q        omit the table of addresses\n");
+    fprintf(stderr, "  -o file   also write the edges read as raw edges\n");
+}
@@ -0,0 +1,249 @@
+/**
+ * @file vcd.c
+ * @brief Implements the streaming value change dump reader.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "vcd.h"
+
+#define T               Vcd_T
+#define VCD_MAX_TOKEN   256
+
+static int Vcd_token(T vcd, char *tok, int len);
+static int Vcd_skip_section(T vcd);
+static int Vcd_timescale(T vcd);
+static int Vcd_var(T vcd, const char *name, const char *bus);
+
+extern int
+Vcd_open(T vcd, FILE *in, const char *name)
+{
+    return Vcd_open_bus(vcd, in, name, NULL);
+}
+
+extern int
+Vcd_open_bus(T vcd, FILE *in, const char *name, const char *bus)
+{
+    char tok[VCD_MAX_TOKEN];
+
+    vcd->in = in;
+    vcd->id[0] = '\0';
+    vcd->bus_id[0] = '\0';
+    vcd->mul = 1;
+    vcd->div = 1;
+    vcd->time = 0;
+    vcd->value = -1;
+
+    while(Vcd_token(vcd, tok, sizeof(tok)))
+    {
+        if(strcmp(tok, "$enddefinitions") == 0)
+        {
+            if(vcd->id[0] == '\0' || (bus != NULL && vcd->bus_id[0] == '\0'))
+                return -1;
+
+            return Vcd_skip_section(vcd);
+        }
+
+        if(strcmp(tok, "$timescale") == 0)
+        {
+            if(Vcd_timescale(vcd) < 0)
+                return -1;
+        }
+        else if(strcmp(tok, "$var") == 0)
+        {
+            Vcd_var(vcd, name, bus);
+        }
+        else if(tok[0] == '$' && strcmp(tok, "$end") != 0)
+        {
+            /* Scopes, comments, dates and the like. */
+            if(Vcd_skip_section(vcd) < 0)
+                return -1;
+        }
+    }
+
+    return -1;
+}
+
+extern int
+Vcd_next_edge(T vcd, uint64_t *time, int *value)
+{
+    char tok[VCD_MAX_TOKEN], id[VCD_MAX_TOKEN];
+    int v;
+
+    while(Vcd_token(vcd, tok, sizeof(tok)))
+    {
+        switch(tok[0])
+        {
+            case '#':
+                vcd->time = strtoull(tok + 1, NULL, 10);
+                break;
+
+            case '0':
+            case '1':
+            case 'x':
+            case 'X':
+            case 'z':
+            case 'Z':
+                if(strcmp(tok + 1, vcd->id) != 0)
+                    break;
+
+                v = (tok[0] == '0' ? 0 : (tok[0] == '1' ? 1 : -1));
+                if(v >= 0 && vcd->value >= 0 && v != vcd->value)
+                {
+                    *time = vcd->time * vcd->mul / vcd->div;
+                    *value = vcd->value = v;
+                    return VCD_EDGE;
+                }
+
+                vcd->value = v;
+                break;
+
+            case 'b':
+            case 'B':
+            case 'r':
+            case 'R':
+                /* A vector or real value, followed by its identifier. */
+                if(!Vcd_token(vcd, id, sizeof(id)))
+                    return VCD_END;
+
+                if((tok[0] == 'b' || tok[0] == 'B') && strcmp(id, vcd->bus_id) == 0)
+                {
+                    *time = vcd->time * vcd->mul / vcd->div;
+                    for(*value = 0, v = 1; tok[v] != '\0'; v++)
+                        *value = (*value << 1) | (tok[v] == '1');
+                    return VCD_BUS;
+                }
+                break;
+
+            case '$':
+                if(strcmp(tok, "$comment") == 0)
+                    Vcd_skip_section(vcd);
+                break;
+        }
+    }
+
+    return VCD_END;
+}
+
+/**
+ * Read the next whitespace separated token.
+ */
+static int
+Vcd_token(T vcd, char *tok, int len)
+{
+    int c, i = 0;
+
+    while((c = getc(vcd->in)) != EOF && isspace(c))
+        ;
+
+    while(c != EOF && !isspace(c))
+    {
+        if(i < (len - 1))
+            tok[i++] = c;
+
+        c = getc(vcd->in);
+    }
+
+    tok[i] = '\0';
+
+    return (i > 0);
+}
+
+static int
+Vcd_skip_section(T vcd)
+{
+    char tok[VCD_MAX_TOKEN];
+
+    while(Vcd_token(vcd, tok, sizeof(tok)))
+    {
+        if(strcmp(tok, "$end") == 0)
+            return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Parse the timescale, written as "1 ns" or "1ns".
+ */
+static int
+Vcd_timescale(T vcd)
+{
+    static const struct
+    {
+        const char *unit;
+        uint64_t mul;
+        uint64_t div;
+    } units[] = {
+        { "s",  1000000000, 1 },
+        { "ms", 1000000,    1 },
+        { "us", 1000,       1 },
+        { "ns", 1,          1 },
+        { "ps", 1,          1000 },
+        { "fs", 1,          1000000 }
+    };
+    char tok[VCD_MAX_TOKEN], spec[VCD_MAX_TOKEN] = "";
+    char *unit;
+    uint64_t mag;
+    int i;
+
+    while(Vcd_token(vcd, tok, sizeof(tok)) && strcmp(tok, "$end") != 0)
+        strncat(spec, tok, sizeof(spec) - strlen(spec) - 1);
+
+    mag = strtoull(spec, &unit, 10);
+    for(i=0; i < (sizeof(units) / sizeof(units[0])); i++)
+    {
+        if(mag > 0 && strcmp(unit, units[i].unit) == 0)
+        {
+            vcd->mul = mag * units[i].mul;
+            vcd->div = units[i].div;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Parse a variable definition, "type width id name [range] $end", and
+ * select it if it is the first one bit signal wanted, or the vector.
+ */
+static int
+Vcd_var(T vcd, const char *name, const char *bus)
+{
+    char type[VCD_MAX_TOKEN], width[VCD_MAX_TOKEN], id[VCD_MAX_TOKEN],
+         var[VCD_MAX_TOKEN];
+
+    if(!Vcd_token(vcd, type, sizeof(type)) || !Vcd_token(vcd, width, sizeof(width))
+        || !Vcd_token(vcd, id, sizeof(id)) || !Vcd_token(vcd, var, sizeof(var)))
+    {
+        return 0;
+    }
+
+    Vcd_skip_section(vcd);
+
+    if(strlen(id) >= VCD_MAX_ID)
+        return 0;
+
+    if(bus != NULL && vcd->bus_id[0] == '\0' && strcmp(width, "1") != 0
+        && strcmp(var, bus) == 0)
+    {
+        strcpy(vcd->bus_id, id);
+        return 1;
+    }
+
+    if(vcd->id[0] != '\0' || strcmp(width, "1") != 0
+        || (name != NULL && strcmp(var, name) != 0))
+    {
+        return 0;
+    }
+
+    strcpy(vcd->id, id);
+
+    return 1;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file vcd.h
+ * @brief Defines a streaming reader for value change dump files.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * Reads the edges of a single one bit signal from a value change dump, as
+ * written by the native build of the command station (see hal_posix.h),
+ * a logic analyser or a logic simulator, and optionally the changes of one
+ * vector signal alongside it. The file is read one token at a time, so
+ * captures of any length are read in constant memory.
+ */
+
+#ifndef VCD_DEFINED
+#define VCD_DEFINED
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define T               Vcd_T
+#define VCD_MAX_ID      16
+
+/*
+ * Changes returned by Vcd_next_edge().
+ */
+#define VCD_END         0   /**< The end of the dump. */
+#define VCD_EDGE        1   /**< An edge of the one bit signal. */
+#define VCD_BUS         2   /**< A value of the vector signal. */
+
+typedef struct T *T;
+struct T
+{
+    FILE *in;
+    char id[VCD_MAX_ID];    /**< The identifier code of the signal. */
+    uint64_t mul;           /**< Nanoseconds per time unit, as mul / div. */
+    uint64_t div;
+    uint64_t time;          /**< The current time, in time units. */
+    int value;              /**< The signal value, or -1 if unknown. */
+    char bus_id[VCD_MAX_ID];    /**< The identifier code of the vector, if any. */
+};
+
+/**
+ * Read the header of a dump and find the signal.
+ *
+ * @param vcd The reader to initialise.
+ * @param in The dump.
+ * @param name The name of the signal, or NULL for the first one bit signal.
+ *
+ * @return 0 on success, or -1 if the header is malformed or the signal is
+ *  not defined.
+ */
+extern int Vcd_open(T vcd, FILE *in, const char *name);
+
+/**
+ * Read the header of a dump and find the signal, as Vcd_open(), and also
+ * a vector signal to follow alongside it.
+ *
+ * @param bus The name of the vector signal.
+ *
+ * @return 0 on success, or -1 if the header is malformed or either signal
+ *  is not defined.
+ */
+extern int Vcd_open_bus(T vcd, FILE *in, const char *name, const char *bus);
+
+/**
+ * Read the next edge of the signal, or value of the vector signal. Every
+ * value written for the vector is returned, even if it repeats the last.
+ *
+ * @param vcd The reader.
+ * @param time Set to the time of the change, in nanoseconds.
+ * @param value Set to the value of the signal after the edge, or the
+ *  value of the vector, with unknown bits as zeros.
+ *
+ * @return VCD_EDGE, VCD_BUS, or VCD_END at the end of the dump.
+ */
+extern int Vcd_next_edge(T vcd, uint64_t *time, int *value);
+
+#undef T
+#endif
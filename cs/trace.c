@@ -0,0 +1,219 @@
+/**
+ * @file trace.c
+ * @brief Implements the transmitted packet trace buffer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "hal.h"
+#include "clock.h"
+#include "scheduler.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_MASK  (TRACE_LEN - 1)
+
+struct Trace_entry
+{
+    uint32_t ms;
+    uint8_t cat;
+    uint8_t size;
+    unsigned char bytes[DCC_MAX_PACKET_SIZE];
+};
+
+static struct Trace_entry Trace_buf[TRACE_LEN];
+
+/**
+ * Packets recorded so far, wrapping at 65536, the next entry is
+ * Trace_count & TRACE_MASK.
+ */
+static volatile uint16_t Trace_count;
+
+/**
+ * Set while the buffer is dumped, which takes longer than the buffer
+ * lasts, so that the entries being printed are not overwritten.
+ */
+static volatile uint8_t Trace_paused;
+
+/**
+ * The position of the live stream, and whether it is enabled.
+ */
+static uint16_t Trace_stream_pos;
+static uint8_t Trace_streaming;
+
+static int Trace_fetch(uint16_t pos, struct Trace_entry *entry);
+static void Trace_print(struct Trace_entry *entry);
+
+extern void
+Trace_module_init(void)
+{
+    uint16_t i;
+
+    HAL_IRQ_DISABLE();
+    for(i=0; i < TRACE_LEN; i++)
+    {
+        /* Never written, there are no empty packets. */
+        Trace_buf[i].size = 0;
+    }
+    Trace_count = 0;
+    Trace_paused = 0;
+    HAL_IRQ_ENABLE();
+
+    Trace_stream_pos = 0;
+    Trace_streaming = 0;
+}
+
+extern void
+Trace_record(uint8_t cat, DCC_packet_T packet)
+{
+    struct Trace_entry *entry = &Trace_buf[Trace_count & TRACE_MASK];
+
+    if(Trace_paused)
+        return;
+
+    entry->ms = Clock_tick_millis();
+    entry->cat = cat;
+    entry->size = packet->size;
+    memcpy(entry->bytes, packet->bytes, packet->size);
+
+    Trace_count++;
+}
+
+extern void
+Trace_dump(int machine)
+{
+    struct Trace_entry entry;
+    uint16_t pos, count;
+    int i, n = 0;
+
+    /* Packets sent while we print go unrecorded. */
+    HAL_IRQ_DISABLE();
+    count = Trace_count;
+    Trace_paused = 1;
+    HAL_IRQ_ENABLE();
+
+    printf_P(machine ? PSTR("trace packets=") : PSTR("trace details (ms, source, bytes)\n"));
+
+    /* The count wraps, so entries not yet written are skipped instead. */
+    for(pos = count - TRACE_LEN; pos != count; pos++)
+    {
+        if(!Trace_fetch(pos, &entry))
+            continue;
+
+        if(machine)
+        {
+            /* Comma separated ms:source:hex. */
+            printf_P(PSTR("%S%" PRIu32 ":%S:"), (n++ > 0 ? PSTR(",") : PSTR("")),
+                     entry.ms, Scheduler_cat_name(entry.cat));
+            for(i=0; i < entry.size; i++)
+                printf_P(PSTR("%02x"), entry.bytes[i]);
+            continue;
+        }
+
+        printf_P(PSTR("  "));
+        Trace_print(&entry);
+    }
+    printf_P(PSTR("\n"));
+
+    Trace_paused = 0;
+}
+
+extern void
+Trace_set_stream(int enable)
+{
+    HAL_IRQ_DISABLE();
+    Trace_stream_pos = Trace_count;
+    HAL_IRQ_ENABLE();
+
+    Trace_streaming = enable;
+}
+
+extern void
+Trace_stream(void)
+{
+    struct Trace_entry entry;
+    uint16_t count;
+
+    if(!Trace_streaming)
+        return;
+
+    HAL_IRQ_DISABLE();
+    count = Trace_count;
+    HAL_IRQ_ENABLE();
+
+    if((uint16_t) (count - Trace_stream_pos) > TRACE_LEN)
+    {
+        printf_P(PSTR("trace lost %u\n"), (count - Trace_stream_pos) - TRACE_LEN);
+        Trace_stream_pos = count - TRACE_LEN;
+    }
+
+    for(; Trace_stream_pos != count; Trace_stream_pos++)
+    {
+        if(Trace_fetch(Trace_stream_pos, &entry) && entry.cat == SCHEDULER_CAT_NEW)
+        {
+            printf_P(PSTR("trace "));
+            Trace_print(&entry);
+        }
+    }
+}
+
+/**
+ * Copy out an entry, if it has been written and not since overwritten.
+ */
+static int
+Trace_fetch(uint16_t pos, struct Trace_entry *entry)
+{
+    int valid;
+
+    HAL_IRQ_DISABLE();
+    if((valid = ((uint16_t) (Trace_count - pos) <= TRACE_LEN
+                 && Trace_buf[pos & TRACE_MASK].size > 0)))
+        *entry = Trace_buf[pos & TRACE_MASK];
+    HAL_IRQ_ENABLE();
+
+    return valid;
+}
+
+static void
+Trace_print(struct Trace_entry *entry)
+{
+    int i;
+
+    printf_P(PSTR("%" PRIu32 " %S"), entry->ms, Scheduler_cat_name(entry->cat));
+    for(i=0; i < entry->size; i++)
+        printf_P(PSTR(" %02x"), entry->bytes[i]);
+    printf_P(PSTR("\n"));
+}
+
+#else
+
+extern void
+Trace_module_init(void)
+{
+}
+
+extern void
+Trace_dump(int machine)
+{
+    if(machine)
+        printf_P(PSTR("trace enabled=0\n"));
+    else
+        printf_P(PSTR("packet trace disabled, rebuild with TRACE_ENABLED\n\n"));
+}
+
+extern void
+Trace_set_stream(int enable)
+{
+}
+
+extern void
+Trace_stream(void)
+{
+}
+
+#endif
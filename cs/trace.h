@@ -0,0 +1,79 @@
+/**
+ * @file trace.h
+ * @brief Defines the transmitted packet trace buffer.
+ * @author Mikey Austin
+ * @date 2012-2013
+ *
+ * The scheduler interrupt handler records every packet it sends to the
+ * track, with its source and the time, in a small circular buffer. The
+ * buffer keeps the last TRACE_LEN packets and is dumped with "show trace".
+ *
+ * New packets may also be streamed live in machine mode as they are sent,
+ * one line per packet:
+ *
+ * @code
+ * trace <milliseconds> new <hex bytes>
+ * @endcode
+ *
+ * Refreshed, stop and idle packets are sent every flush period and would
+ * swamp the serial link, so only the buffer holds those.
+ *
+ * The trace is enabled by defining TRACE_ENABLED (see the Makefile),
+ * otherwise TRACE_RECORD expands to nothing.
+ */
+
+#ifndef TRACE_DEFINED
+#define TRACE_DEFINED
+
+#include <stdint.h>
+
+#include "config.h"
+#include "dcc.h"
+
+#define TRACE_LEN   CONFIG_TRACE_LEN    /**< Packets kept, must be a power of two. */
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_RECORD(cat, packet)   Trace_record((cat), (packet))
+
+/**
+ * Record a packet sent to the track. Called only by the scheduler
+ * interrupt handler.
+ *
+ * @param cat One of the SCHEDULER_CAT_* sources.
+ * @param packet The packet sent.
+ */
+extern void Trace_record(uint8_t cat, DCC_packet_T packet);
+
+#else
+
+#define TRACE_RECORD(cat, packet)
+
+#endif
+
+/** Reset the trace buffer. */
+extern void Trace_module_init(void);
+
+/**
+ * Print the traced packets, oldest first. Recording is paused until the
+ * dump is done, so the packets sent meanwhile are not traced.
+ *
+ * @param machine Non-zero to print a single line, the packets as a comma
+ *  separated list of milliseconds:source:hex.
+ */
+extern void Trace_dump(int machine);
+
+/**
+ * Enable or disable live streaming of new packets.
+ *
+ * @param enable Non-zero to stream.
+ */
+extern void Trace_set_stream(int enable);
+
+/**
+ * Print any new packets traced since the last call, if streaming is
+ * enabled. Called from the main loop in machine mode.
+ */
+extern void Trace_stream(void);
+
+#endif
@@ -5,24 +5,65 @@
  * @date 2010-2011
  */
  
-#include "init.h"
-#include <avr/io.h>
-#include <util/delay.h>
+#include <stdio.h>
+
+#include "hal.h"
 #include "utils.h"
 
+#define UTILS_PERCENT_SCALE 10000UL /**< Hundredths of a percent. */
+
+static uint32_t Utils_hundredths(uint32_t part, uint32_t whole);
+
 extern void
 blink_led(unsigned char led, int times)
 {
     int i;
 
-    UTILS_OUT_DDR = 0xFF;
-
     for(i=0; i < times; i++)
     {
-        UTILS_OUT_PORT |= led;
-        _delay_ms(25);
+        HAL_LED_ON(led);
+        HAL_DELAY_MS(25);
+
+        HAL_LED_OFF(led);
+        HAL_DELAY_MS(25);
+    }
+}
+
+static uint32_t
+Utils_hundredths(uint32_t part, uint32_t whole)
+{
+    uint32_t hundredths = 0;
+
+    if(whole > 0)
+    {
+        /* Scale both down, keeping the ratio, until the part can be scaled up. */
+        while(part > (UINT32_MAX / UTILS_PERCENT_SCALE))
+        {
+            part >>= 1;
+            whole >>= 1;
+        }
 
-        UTILS_OUT_PORT &= ~led;
-        _delay_ms(25);
+        /* Only a part much larger than the whole can lose the whole. */
+        hundredths = (part * UTILS_PERCENT_SCALE) / (whole > 0 ? whole : 1);
     }
+
+    return hundredths;
+}
+
+extern void
+print_percent(uint32_t part, uint32_t whole)
+{
+    uint32_t hundredths = Utils_hundredths(part, whole);
+
+    printf_P(PSTR("%u.%02u%%"), (unsigned) (hundredths / 100),
+             (unsigned) (hundredths % 100));
+}
+
+extern void
+print_percent_value(uint32_t part, uint32_t whole)
+{
+    uint32_t hundredths = Utils_hundredths(part, whole);
+
+    printf_P(PSTR("%u.%02u"), (unsigned) (hundredths / 100),
+             (unsigned) (hundredths % 100));
 }
@@ -8,18 +8,17 @@
 #ifndef UTILS_DEFINED
 #define UTILS_DEFINED
 
-#include <avr/io.h>
+#include <stdint.h>
 
-#define LED1 (1 << PB6)
-#define LED2 (1 << PB7)
+#include "hal.h"
 
-#define UTILS_OUT_DDR   DDRB
-#define UTILS_OUT_PORT  PORTB
+#define LED1 HAL_LED1
+#define LED2 HAL_LED2
 
-#define LED1_ON     UTILS_OUT_DDR = 0xFF; (UTILS_OUT_PORT |= LED1)
-#define LED1_OFF    UTILS_OUT_DDR = 0xFF; (UTILS_OUT_PORT &= ~LED1)
-#define LED2_ON     UTILS_OUT_DDR = 0xFF; (UTILS_OUT_PORT |= LED2)
-#define LED2_OFF    UTILS_OUT_DDR = 0xFF; (UTILS_OUT_PORT &= ~LED2)
+#define LED1_ON     HAL_LED_ON(LED1)
+#define LED1_OFF    HAL_LED_OFF(LED1)
+#define LED2_ON     HAL_LED_ON(LED2)
+#define LED2_OFF    HAL_LED_OFF(LED2)
 
 /**
  * Blink the desired LED.
@@ -29,4 +28,21 @@
  */
 extern void blink_led(unsigned char led, int times);
 
+/**
+ * Print a percentage to two decimal places, eg "12.34%".
+ *
+ * Only integer arithmetic is used, so the floating point printf and maths
+ * libraries need not be linked.
+ *
+ * @param part The part of the whole, no larger than the whole.
+ * @param whole The whole, a zero whole prints as zero.
+ */
+extern void print_percent(uint32_t part, uint32_t whole);
+
+/**
+ * Print a percentage as print_percent() does, without the percent sign,
+ * for machine mode key=value output, eg "12.34".
+ */
+extern void print_percent_value(uint32_t part, uint32_t whole);
+
 #endif